@@ -0,0 +1,560 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "bmp_io.h"
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+// IORING_FEAT_RW_CUR_POS came with IORING_OP_READ/WRITE (Linux 5.6), which is all we need
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(IORING_FEAT_RW_CUR_POS)
+#define BMP_IO_HAVE_URING 1
+#endif
+#endif
+#endif
+
+// Life cycle of a pipeline slot: read into, embedded, written back (then free again)
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_READ,
+    SLOT_EMBEDDED
+} SlotState;
+
+typedef struct {
+    unsigned char *buffer;      // rows_per_block rows of row_stride bytes
+    size_t len;                 // Bytes of the block present in the file (last one may be short)
+    off_t offset;               // File offset of the block (same in carrier and output)
+    uint32_t first_row;         // Storage index of the first row in the block
+    uint32_t rows;              // Rows in the block
+    SlotState state;
+} PipelineSlot;
+
+typedef struct {
+    BMPImage *image;
+    bmp_span_callback_t callback;
+    void *ctx;
+    size_t ctx_size;
+    PipelineSlot slots[PIPELINE_DEPTH];
+    uint32_t rows_per_block;
+    uint32_t row_count;
+    size_t block_count;
+    pthread_mutex_t lock;       // Thread backend: guards slot states and failed
+    pthread_cond_t changed;
+    int failed;
+} Pipeline;
+
+/**
+ * @brief Fills in the geometry of block `block` (rows, file offset and length) in its slot.
+ */
+static void setup_block(const Pipeline *p, size_t block, PipelineSlot *slot) {
+    const BMPImage *image = p->image;
+
+    slot->first_row = (uint32_t)(block * p->rows_per_block);
+    slot->rows = p->row_count - slot->first_row < p->rows_per_block ? p->row_count - slot->first_row : p->rows_per_block;
+
+    size_t start = image->fileHeader->bfOffBits + (size_t)slot->first_row * image->row_stride;
+    size_t end = start + (size_t)slot->rows * image->row_stride;
+    if (end > image->in_size) {
+        end = image->in_size;   // The last row may omit its padding
+    }
+    slot->offset = (off_t)start;
+    slot->len = end - start;
+}
+
+/**
+ * @brief Runs the embedding callback over the rows held by a slot.
+ */
+static void embed_block(const Pipeline *p, PipelineSlot *slot) {
+    parallel_bmp_rows(p->image, slot->buffer, slot->first_row, slot->rows, p->callback, p->ctx, p->ctx_size, NULL);
+}
+
+/**
+ * @brief pread/pwrite until len bytes are transferred. A read hitting EOF is an error (truncated carrier).
+ * Streamed descriptors (pipes) use read/write instead: blocks come in file order, so the
+ * current position always is the block offset.
+ * @return 0 on success, -1 on error.
+ */
+static int transfer_full(int fd, unsigned char *buffer, size_t len, off_t offset, int is_write, int streamed) {
+    while (len > 0) {
+        ssize_t n;
+        if (streamed) {
+            n = is_write ? write(fd, buffer, len) : read(fd, buffer, len);
+        } else {
+            n = is_write ? pwrite(fd, buffer, len, offset) : pread(fd, buffer, len, offset);
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            return -1;
+        }
+        buffer += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+// -------------------------------------- Thread backend --------------------------------------
+
+static void fail_pipeline(Pipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * @brief Blocks until the slot reaches `state`.
+ * @return 1 when it did, 0 if the pipeline failed meanwhile.
+ */
+static int wait_slot(Pipeline *p, PipelineSlot *slot, SlotState state) {
+    pthread_mutex_lock(&p->lock);
+    while (slot->state != state && !p->failed) {
+        pthread_cond_wait(&p->changed, &p->lock);
+    }
+    int ok = !p->failed;
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+static void set_slot(Pipeline *p, PipelineSlot *slot, SlotState state) {
+    pthread_mutex_lock(&p->lock);
+    slot->state = state;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void *pipeline_reader(void *arg) {
+    Pipeline *p = (Pipeline *)arg;
+
+    for (size_t block = 0; block < p->block_count; block++) {
+        PipelineSlot *slot = &p->slots[block % PIPELINE_DEPTH];
+        if (!wait_slot(p, slot, SLOT_FREE)) break;
+
+        setup_block(p, block, slot);
+        if (transfer_full(p->image->in_fd, slot->buffer, slot->len, slot->offset, 0, p->image->in_streamed) != 0) {
+            fail_pipeline(p);
+            break;
+        }
+        set_slot(p, slot, SLOT_READ);
+    }
+    return NULL;
+}
+
+static void *pipeline_writer(void *arg) {
+    Pipeline *p = (Pipeline *)arg;
+
+    for (size_t block = 0; block < p->block_count; block++) {
+        PipelineSlot *slot = &p->slots[block % PIPELINE_DEPTH];
+        if (!wait_slot(p, slot, SLOT_EMBEDDED)) break;
+
+        if (transfer_full(p->image->out_fd, slot->buffer, slot->len, slot->offset, 1, p->image->out_streamed) != 0) {
+            fail_pipeline(p);
+            break;
+        }
+        set_slot(p, slot, SLOT_FREE);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reader and writer threads around the caller, which embeds the blocks in order.
+ * @return 0 on success, -1 on error.
+ */
+static int run_thread_pipeline(Pipeline *p) {
+    pthread_t reader, writer;
+
+    if (pthread_mutex_init(&p->lock, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&p->changed, NULL) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        return -1;
+    }
+
+    int reader_started = pthread_create(&reader, NULL, pipeline_reader, p) == 0;
+    int writer_started = reader_started && pthread_create(&writer, NULL, pipeline_writer, p) == 0;
+    if (!writer_started) {
+        fail_pipeline(p);
+    }
+
+    for (size_t block = 0; writer_started && block < p->block_count; block++) {
+        PipelineSlot *slot = &p->slots[block % PIPELINE_DEPTH];
+        if (!wait_slot(p, slot, SLOT_READ)) break;
+
+        embed_block(p, slot);
+        set_slot(p, slot, SLOT_EMBEDDED);
+    }
+
+    if (reader_started) pthread_join(reader, NULL);
+    if (writer_started) pthread_join(writer, NULL);
+
+    int result = p->failed ? -1 : 0;
+    pthread_cond_destroy(&p->changed);
+    pthread_mutex_destroy(&p->lock);
+    return result;
+}
+
+// -------------------------------------- io_uring backend --------------------------------------
+
+#ifdef BMP_IO_HAVE_URING
+
+typedef struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned pending;           // SQEs queued but not yet submitted
+} URing;
+
+static void uring_free(URing *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+/**
+ * @brief Sets up a ring with the raw syscalls (no liburing dependency) and maps its queues.
+ * @return 0 on success, -1 if io_uring is unavailable (old kernel, seccomp, disabled by sysctl).
+ */
+static int uring_init(URing *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        uring_free(ring);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            uring_free(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        uring_free(ring);
+        return -1;
+    }
+
+    unsigned char *sq = ring->sq_ring;
+    unsigned char *cq = ring->cq_ring;
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/**
+ * @brief Queues a read or write of a whole slot. user_data encodes (block << 1) | is_write.
+ */
+static void uring_queue_block(URing *ring, const Pipeline *p, const PipelineSlot *slot, size_t block, int is_write) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = is_write ? p->image->out_fd : p->image->in_fd;
+    sqe->off = (uint64_t)slot->offset;
+    sqe->addr = (uint64_t)(uintptr_t)slot->buffer;
+    sqe->len = (uint32_t)slot->len;
+    sqe->user_data = ((uint64_t)block << 1) | (uint64_t)is_write;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+/**
+ * @brief Submits the queued SQEs and waits for at least one completion.
+ * @return 0 on success, -1 on error.
+ */
+static int uring_submit_and_wait(URing *ring) {
+    for (;;) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        ring->pending -= (unsigned)ret;
+        return 0;
+    }
+}
+
+/**
+ * @brief Single-threaded event loop: up to PIPELINE_DEPTH blocks are read or written
+ * asynchronously while the caller embeds the next ready block in order.
+ * @return 0 on success, -1 on error.
+ */
+static int run_uring_loop(Pipeline *p, URing *ring) {
+    size_t next_embed = 0;
+    size_t written = 0;
+    unsigned inflight = 0;
+    int failed = 0;
+
+    for (size_t block = 0; block < p->block_count && block < PIPELINE_DEPTH; block++) {
+        setup_block(p, block, &p->slots[block]);
+        uring_queue_block(ring, p, &p->slots[block], block, 0);
+        inflight++;
+    }
+
+    // Always drain what is in flight: the kernel still owns those buffers
+    while (inflight > 0) {
+        if (uring_submit_and_wait(ring) != 0) {
+            return -1;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            size_t block = (size_t)(cqe->user_data >> 1);
+            int is_write = (int)(cqe->user_data & 1);
+            PipelineSlot *slot = &p->slots[block % PIPELINE_DEPTH];
+            inflight--;
+
+            if (failed) continue;
+
+            // Short transfers are finished synchronously
+            size_t done = cqe->res < 0 ? 0 : (size_t)cqe->res;
+            int fd = is_write ? p->image->out_fd : p->image->in_fd;
+            if (cqe->res < 0 || transfer_full(fd, slot->buffer + done, slot->len - done, slot->offset + (off_t)done, is_write, 0) != 0) {
+                failed = 1;
+                continue;
+            }
+
+            if (!is_write) {
+                slot->state = SLOT_READ;
+                continue;
+            }
+
+            // Block written: its slot takes the block DEPTH positions ahead
+            slot->state = SLOT_FREE;
+            written++;
+            if (block + PIPELINE_DEPTH < p->block_count) {
+                setup_block(p, block + PIPELINE_DEPTH, slot);
+                uring_queue_block(ring, p, slot, block + PIPELINE_DEPTH, 0);
+                inflight++;
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        // Embed, in order, every block that has arrived and queue its write
+        while (!failed && next_embed < p->block_count && p->slots[next_embed % PIPELINE_DEPTH].state == SLOT_READ) {
+            PipelineSlot *slot = &p->slots[next_embed % PIPELINE_DEPTH];
+            embed_block(p, slot);
+            slot->state = SLOT_EMBEDDED;
+            uring_queue_block(ring, p, slot, next_embed, 1);
+            inflight++;
+            next_embed++;
+        }
+    }
+
+    return (failed || written < p->block_count) ? -1 : 0;
+}
+
+/**
+ * @return 1 if the ring could be set up (*result then holds the outcome), 0 otherwise.
+ */
+static int run_uring_pipeline(Pipeline *p, size_t slot_size, int *result) {
+    URing ring;
+
+    if (slot_size > UINT32_MAX || uring_init(&ring, PIPELINE_DEPTH * 2) != 0) {
+        return 0;
+    }
+
+    *result = run_uring_loop(p, &ring);
+    uring_free(&ring);
+    return 1;
+}
+
+#else
+
+static int run_uring_pipeline(Pipeline *p, size_t slot_size, int *result) {
+    (void)p;
+    (void)slot_size;
+    (void)result;
+    return 0;
+}
+
+#endif
+
+int pipeline_bmp_rows(BMPImage *image, uint32_t row_count, bmp_span_callback_t callback, void *ctx, size_t ctx_size) {
+    if (!image || image->in_fd < 0 || image->out_fd < 0 || row_count > image->height) {
+        fprintf(stderr, "Invalid image or output file\n");
+        return -1;
+    }
+    if (row_count == 0) {
+        return 0;
+    }
+
+    Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.image = image;
+    p.callback = callback;
+    p.ctx = ctx;
+    p.ctx_size = ctx_size;
+    p.row_count = row_count;
+
+    // Blocks of whole rows, at least one row each
+    size_t rows_per_block = PIPELINE_BLOCK_SIZE / image->row_stride;
+    if (rows_per_block == 0) rows_per_block = 1;
+    if (rows_per_block > row_count) rows_per_block = row_count;
+    p.rows_per_block = (uint32_t)rows_per_block;
+    p.block_count = (row_count + rows_per_block - 1) / rows_per_block;
+
+    size_t slot_size = rows_per_block * image->row_stride;
+    size_t slots = p.block_count < PIPELINE_DEPTH ? p.block_count : PIPELINE_DEPTH;
+    int result = -1;
+
+    for (size_t i = 0; i < slots; i++) {
+        p.slots[i].buffer = malloc(slot_size);
+        if (!p.slots[i].buffer) {
+            fprintf(stderr, "Error: Failed to allocate memory for the I/O pipeline.\n");
+            goto cleanup;
+        }
+    }
+
+    // The ring reads and writes at explicit offsets: streams go through the thread backend
+    if (image->io_engine == BMP_IO_URING && !image->in_streamed && !image->out_streamed) {
+        if (run_uring_pipeline(&p, slot_size, &result)) {
+            goto cleanup;
+        }
+        fprintf(stderr, "Warning: io_uring not available, falling back to the threaded I/O pipeline.\n");
+    }
+    result = run_thread_pipeline(&p);
+
+    cleanup:
+    for (size_t i = 0; i < slots; i++) {
+        free(p.slots[i].buffer);
+    }
+
+    return result;
+}
+
+// -------------------------------------- Parallel row walk --------------------------------------
+
+typedef struct {
+    const BMPImage *image;
+    unsigned char *rows_start;
+    uint32_t first_row;
+    uint32_t row_count;
+    bmp_span_callback_t callback;
+    void *ctx;                  // Private copy of the caller's context
+} RowWorker;
+
+static void *row_worker_main(void *arg) {
+    RowWorker *worker = (RowWorker *)arg;
+    iterate_bmp_buffer_rows(worker->image, worker->rows_start, worker->first_row, worker->row_count,
+                            worker->callback, worker->ctx);
+    return NULL;
+}
+
+int parallel_bmp_rows(const BMPImage *image, unsigned char *rows_start, uint32_t first_row, uint32_t row_count,
+                      bmp_span_callback_t callback, void *ctx, size_t ctx_size, bmp_ctx_merge_t merge) {
+    if (!image || !rows_start || first_row > image->height || row_count > image->height - first_row) {
+        fprintf(stderr, "Invalid image or output file\n");
+        return -1;
+    }
+
+    unsigned int workers = image->threads;
+    if (workers > MAX_EMBED_THREADS) workers = MAX_EMBED_THREADS;
+    if (workers > row_count) workers = row_count;
+    if (workers <= 1 || ctx_size == 0) {
+        iterate_bmp_buffer_rows(image, rows_start, first_row, row_count, callback, ctx);
+        return 0;
+    }
+
+    RowWorker pool[MAX_EMBED_THREADS];
+    pthread_t tids[MAX_EMBED_THREADS];
+    int started[MAX_EMBED_THREADS] = {0};
+    unsigned char *contexts = malloc(ctx_size * workers);
+    if (!contexts) {
+        // Not worth failing the embed over: walk the rows on this thread
+        iterate_bmp_buffer_rows(image, rows_start, first_row, row_count, callback, ctx);
+        return 0;
+    }
+
+    // Contiguous, balanced ranges: the first row_count % workers ranges get one extra row
+    uint32_t next_row = first_row;
+    for (unsigned int w = 0; w < workers; w++) {
+        uint32_t rows = row_count / workers + (w < row_count % workers ? 1 : 0);
+        pool[w].image = image;
+        pool[w].rows_start = rows_start + (size_t)(next_row - first_row) * image->row_stride;
+        pool[w].first_row = next_row;
+        pool[w].row_count = rows;
+        pool[w].callback = callback;
+        pool[w].ctx = contexts + (size_t)w * ctx_size;
+        memcpy(pool[w].ctx, ctx, ctx_size);
+        next_row += rows;
+    }
+
+    // The calling thread takes the first range; a worker that cannot be started runs here too
+    for (unsigned int w = 1; w < workers; w++) {
+        started[w] = pthread_create(&tids[w], NULL, row_worker_main, &pool[w]) == 0;
+    }
+    row_worker_main(&pool[0]);
+    for (unsigned int w = 1; w < workers; w++) {
+        if (started[w]) {
+            pthread_join(tids[w], NULL);
+        } else {
+            row_worker_main(&pool[w]);
+        }
+    }
+
+    if (merge) {
+        for (unsigned int w = 0; w < workers; w++) {
+            merge(ctx, pool[w].ctx);
+        }
+    } else {
+        memcpy(ctx, pool[workers - 1].ctx, ctx_size);
+    }
+    free(contexts);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include "bmp_lib.h"
+
+// Pipeline geometry: each block holds whole rows, several blocks are in flight at once
+#define PIPELINE_BLOCK_SIZE (4 * 1024 * 1024)   // Target bytes per block (at least one row)
+#define PIPELINE_DEPTH 4                        // Blocks in flight (read, embed and write overlap)
+#define MAX_EMBED_THREADS 256                   // Upper bound for image->threads
+
+// Folds the context copy of one parallel_bmp_rows worker back into the caller's context
+typedef void (*bmp_ctx_merge_t)(void *ctx, const void *worker_ctx);
+
+/**
+ * @brief Streams the first row_count stored rows from the carrier to the output through callback
+ * Rows are read from image->in_fd in blocks of whole rows, handed to callback in storage
+ * order (see iterate_bmp_buffer_rows) and written back to image->out_fd at the same
+ * offset. While one block is being embedded, the next ones are being read and the
+ * previous ones written, so disk latency overlaps with the embedding.
+ * image->io_engine selects the backend: BMP_IO_URING submits the reads and writes
+ * through an io_uring ring and falls back to BMP_IO_THREADS (a reader and a writer
+ * thread around the caller) when io_uring is not available.
+ * Only the bytes covered by those rows are written (the last block stops at the end of
+ * the carrier, whose last row may omit its padding).
+ * A streamed carrier or output (image->in_streamed / out_streamed) is read or written
+ * front to back instead, always through the thread backend; the stream must then be
+ * positioned at the first row.
+ * @param image Pointer to BMPImage structure with an open, pre-sized output descriptor
+ * @param row_count Number of stored rows to process, starting at the first one
+ * Each block is embedded with parallel_bmp_rows, so image->threads workers share it when
+ * ctx_size is not 0.
+ * @param callback Function called once per row span, in storage order
+ * @param ctx Context pointer passed to callback function
+ * @param ctx_size Size of *ctx for a parallel embed of each block, 0 for the calling thread only
+ * @return 0 on success, -1 on I/O error
+ */
+int pipeline_bmp_rows(BMPImage *image, uint32_t row_count, bmp_span_callback_t callback, void *ctx, size_t ctx_size);
+
+/**
+ * @brief Passes row_count stored rows held in memory through callback, split among image->threads workers
+ * The rows are cut into one contiguous range per worker; every worker walks its range in
+ * storage order (see iterate_bmp_buffer_rows) with its own copy of *ctx, so the callback
+ * has to derive its position from each span (e.g. payload bit = first_pixel * bits per
+ * pixel), not from the rows visited before. When all workers are done, *ctx is replaced
+ * by the copy that processed the last range, as if one thread had walked every row; with
+ * a merge function, each copy is instead folded into *ctx in row order (accumulators in
+ * *ctx must then start empty, since every copy starts from them).
+ * With one worker, or ctx_size 0, the rows are walked on the calling thread with ctx itself.
+ * @param image Pointer to BMPImage structure (geometry and threads)
+ * @param rows_start First byte of stored row first_row
+ * @param first_row Storage index of the first row
+ * @param row_count Number of rows
+ * @param callback Function called once per row span
+ * @param ctx Context pointer passed to callback function
+ * @param ctx_size Size of *ctx (0 = not copyable, walk serially)
+ * @param merge Reduction of the worker copies into *ctx (NULL = keep the last copy)
+ * @return 0 on success, -1 on error (invalid range)
+ */
+int parallel_bmp_rows(const BMPImage *image, unsigned char *rows_start, uint32_t first_row, uint32_t row_count,
+                      bmp_span_callback_t callback, void *ctx, size_t ctx_size, bmp_ctx_merge_t merge);
+
+#endif // BMP_IO_H
@@ -1,63 +1,245 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
 
 #include "bmp_lib.h"
+#include "bmp_io.h"
 #include "error.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+/**
+ * @brief Reads up to len bytes from a descriptor, stopping early only at end of file.
+ * @return Number of bytes read (less than len at end of file), -1 on error.
+ */
+static ssize_t read_full_fd(int fd, unsigned char *buffer, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, buffer + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+/**
+ * @brief Writes len bytes at the current position of a descriptor (pipes included).
+ * @return 0 on success, -1 on error.
+ */
+static int write_full_fd(int fd, const unsigned char *buffer, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buffer, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buffer += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the headers of a streamed carrier: everything up to bfOffBits, nothing more.
+ * @return Heap buffer with the headers, NULL on error. *size_out receives bfOffBits.
+ */
+static unsigned char *read_stream_headers(int fd, size_t *size_out) {
+    BMPFileHeader file_header;
+    if (read_full_fd(fd, (unsigned char *)&file_header, sizeof(file_header)) != (ssize_t)sizeof(file_header) ||
+        file_header.bfOffBits < HEADER_SIZE || file_header.bfOffBits > MAX_STREAM_HEADER_SIZE) {
+        return NULL;
+    }
+
+    size_t size = file_header.bfOffBits;
+    unsigned char *buffer = malloc(size);
+    if (!buffer) return NULL;
+
+    memcpy(buffer, &file_header, sizeof(file_header));
+    size_t rest = size - sizeof(file_header);
+    if (read_full_fd(fd, buffer + sizeof(file_header), rest) != (ssize_t)rest) {
+        free(buffer);
+        return NULL;
+    }
+
+    *size_out = size;
+    return buffer;
+}
+
+/**
+ * @brief Adapter that lets per-pixel callbacks run on top of the span iterator.
+ */
+typedef struct {
+    void (*callback)(Pixel *byte, void *ctx);
+    void *ctx;
+} PixelCallbackShim;
+
+static void pixel_callback_shim(const BMPSpan *span, void *ctx) {
+    PixelCallbackShim *shim = (PixelCallbackShim *)ctx;
+    for (size_t i = 0; i < span->pixel_count; i++) {
+        shim->callback((Pixel *)(span->pixels + i * span->pixel_stride), shim->ctx);
+    }
+}
 
 void iterate_bmp(BMPImage *image,
     void (*callback)(Pixel *byte, void *ctx),
     void *ctx) {
 
-    if (!image || !image->in || !image->out) {
+    PixelCallbackShim shim = { .callback = callback, .ctx = ctx };
+    iterate_bmp_spans(image, 0, pixel_callback_shim, &shim);
+}
+
+void iterate_bmp_rows(BMPImage *image, bmp_span_callback_t callback, void *ctx) {
+    iterate_bmp_spans(image, 0, callback, ctx);
+}
+
+/**
+ * @brief Core span loop over row_count stored rows laid out contiguously from rows_start.
+ * @param first_row Storage index of the row at rows_start (used for row/first_pixel).
+ */
+static void visit_rows(const BMPImage *image, unsigned char *rows_start, uint32_t first_row, uint32_t row_count,
+                       size_t max_span_pixels, bmp_span_callback_t callback, void *ctx) {
+    if (max_span_pixels == 0 || max_span_pixels > image->width) {
+        max_span_pixels = image->width;
+    }
+
+    BMPSpan span = { .stride = image->row_stride, .pixel_stride = image->bytes_per_pixel };
+    unsigned char *row_start = rows_start;
+
+    // Rows are visited in storage order so the stego bit order follows the file
+    for (uint32_t r = first_row; r < first_row + row_count; r++, row_start += image->row_stride) {
+        span.row = image->top_down ? r : image->height - 1 - r;
+
+        for (uint32_t column = 0; column < image->width; column += span.pixel_count) {
+            span.pixels = row_start + (size_t)column * image->bytes_per_pixel;
+            span.pixel_count = image->width - column;
+            if (span.pixel_count > max_span_pixels) {
+                span.pixel_count = max_span_pixels;
+            }
+            span.column = column;
+            span.first_pixel = (size_t)r * image->width + column;
+            callback(&span, ctx);   // apply chosen algorithm
+        }
+    }
+}
+
+void iterate_bmp_spans(BMPImage *image, size_t max_span_pixels, bmp_span_callback_t callback, void *ctx) {
+    if (!image || !image->data) {
         fprintf(stderr, ERR_INVALID_BMP);
         return;
     }
-    
-    // Process pixels
-    Pixel pixel;
-    while (fread(&pixel, sizeof(Pixel), 1, image->in) == 1) {
-        callback(&pixel, ctx);   // apply chosen algorithm
-        if (fwrite(&pixel, sizeof(Pixel), 1, image->out) != 1) {
-            fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
-            return;
-        }
+
+    visit_rows(image, (unsigned char *)image->data, 0, image->height, max_span_pixels, callback, ctx);
+}
+
+void iterate_bmp_buffer_rows(const BMPImage *image, unsigned char *buffer, uint32_t first_row, uint32_t row_count,
+                             bmp_span_callback_t callback, void *ctx) {
+    if (!image || !buffer || first_row > image->height || row_count > image->height - first_row) {
+        fprintf(stderr, ERR_INVALID_BMP);
+        return;
+    }
+
+    visit_rows(image, buffer, first_row, row_count, 0, callback, ctx);
+}
+
+Pixel * get_pixel(const BMPImage *image, size_t pixel_idx) {
+    if (!image || pixel_idx >= get_loaded_pixel_count(image)) {
+        return NULL;
+    }
+
+    size_t row = pixel_idx / image->width;
+    size_t column = pixel_idx % image->width;
+    size_t first_row = image->in_dropped / image->row_stride;   // Rows released by release_bmp_pixels
+    if (row < first_row) {
+        return NULL;
     }
+    return (Pixel *)((unsigned char *)image->data + (row - first_row) * image->row_stride + column * image->bytes_per_pixel);
 }
 
 BMPImage * open_bmp(const char *bmp_in){
-    FILE *in = fopen(bmp_in, "rb");
-    if (!in) {
+    int fd = strcmp(bmp_in, STDIO_PATH) == 0 ? dup(STDIN_FILENO) : open(bmp_in, O_RDONLY);
+    if (fd < 0) {
         perror(ERR_FAILED_TO_OPEN_BMP);
         return NULL;
     }
 
     BMPImage *image = malloc(sizeof(BMPImage));
+    if (!image) {
+        close(fd);
+        return NULL;
+    }
     // Copiar header intacto
     BMPFileHeader * fileHeader = malloc(sizeof(BMPFileHeader));
     BMPInfoHeader * infoHeader = malloc(sizeof(BMPInfoHeader));
-    
+
     image->fileHeader = fileHeader;
     image->infoHeader = infoHeader;
-    image->in = in;
-    image->out = NULL;
     image->data = NULL;
+    image->in_map = NULL;
+    image->in_size = 0;
+    image->in_fd = fd;
+    image->in_mapped = 0;
+    image->in_streamed = 0;
+    image->in_loaded = 0;
+    image->in_dropped = 0;
+    image->out_map = NULL;
+    image->out_size = 0;
+    image->out_fd = -1;
+    image->out_cloned = 0;
+    image->out_streamed = 0;
+    image->width = 0;
+    image->height = 0;
+    image->top_down = 0;
+    image->row_stride = 0;
+    image->bytes_per_pixel = BGR_PIXEL_SIZE;
+    image->io_engine = BMP_IO_MMAP;
+    image->threads = 1;
 
     if (!image->fileHeader || !image->infoHeader) {
         free_bmp_image(image); // Cleans up struct and closes file
         return NULL;
     }
 
-    // Read BMP File Header
-    if (fread(image->fileHeader, sizeof(BMPFileHeader), 1, image->in) != 1) {
-        fprintf(stderr, ERR_FAILED_TO_READ_BMP);
-        free_bmp_image(image);
-        return NULL;
+    // Map the carrier read-only; non-mappable inputs (pipes) are streamed from their headers on
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            image->in_map = map;
+            image->in_size = (size_t)st.st_size;
+            image->in_mapped = 1;
+        }
+    }
+    if (!image->in_map) {
+        image->in_map = read_stream_headers(fd, &image->in_size);
+        image->in_streamed = 1;
+        image->in_loaded = image->in_size;
+        if (!image->in_map) {
+            fprintf(stderr, ERR_FAILED_TO_READ_BMP);
+            free_bmp_image(image);
+            return NULL;
+        }
     }
 
-    // Read BMP Info Header
-    if (fread(image->infoHeader, sizeof(BMPInfoHeader), 1, image->in) != 1) {
+    // Read BMP File Header and BMP Info Header
+    if (image->in_size < HEADER_SIZE) {
         fprintf(stderr, ERR_FAILED_TO_READ_BMP);
         free_bmp_image(image);
         return NULL;
     }
+    memcpy(image->fileHeader, image->in_map, sizeof(BMPFileHeader));
+    memcpy(image->infoHeader, image->in_map + sizeof(BMPFileHeader), sizeof(BMPInfoHeader));
 
     // Validate BMP (Project Requirements)
     if (image->fileHeader->bfType != 0x4D42) { // 'BM'
@@ -66,97 +248,583 @@ BMPImage * open_bmp(const char *bmp_in){
         return NULL;
     }
 
-    if (image->infoHeader->biBitCount != 24) {
-        fprintf(stderr, ERR_INVALID_BMP " (Must be 24-bit)\n");
+    // BITMAPINFOHEADER (40 bytes) or a larger V4/V5 header; extra header bytes are kept as-is
+    if (image->infoHeader->biSize < sizeof(BMPInfoHeader) ||
+        image->infoHeader->biSize > image->in_size - sizeof(BMPFileHeader)) {
+        fprintf(stderr, ERR_INVALID_BMP " (Unsupported info header)\n");
         free_bmp_image(image);
         return NULL;
     }
 
-    if (image->infoHeader->biCompression != 0) {
+    if (image->infoHeader->biBitCount != 24 && image->infoHeader->biBitCount != 32) {
+        fprintf(stderr, ERR_INVALID_BMP " (Must be 24-bit or 32-bit)\n");
+        free_bmp_image(image);
+        return NULL;
+    }
+    image->bytes_per_pixel = image->infoHeader->biBitCount == 32 ? BGRA_PIXEL_SIZE : BGR_PIXEL_SIZE;
+
+    if (image->infoHeader->biCompression != BI_RGB &&
+        !(image->bytes_per_pixel == BGRA_PIXEL_SIZE && image->infoHeader->biCompression == BI_BITFIELDS)) {
         fprintf(stderr, ERR_INVALID_BMP " (Must be uncompressed)\n");
         free_bmp_image(image);
         return NULL;
     }
 
-    // Seek to pixel data
-    fseek(image->in, image->fileHeader->bfOffBits, SEEK_SET);
-    
+    // BI_BITFIELDS: the R, G, B masks follow the 40-byte header (V4/V5 store them in the same place)
+    if (image->infoHeader->biCompression == BI_BITFIELDS) {
+        uint32_t masks[3];
+        size_t masks_offset = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+        if (image->in_size < masks_offset + sizeof(masks)) {
+            fprintf(stderr, ERR_FAILED_TO_READ_BMP);
+            free_bmp_image(image);
+            return NULL;
+        }
+        memcpy(masks, image->in_map + masks_offset, sizeof(masks));
+        if (masks[0] != 0x00FF0000 || masks[1] != 0x0000FF00 || masks[2] != 0x000000FF) {
+            fprintf(stderr, ERR_INVALID_BMP " (Only BGRA channel masks are supported)\n");
+            free_bmp_image(image);
+            return NULL;
+        }
+    }
+
+    // Geometry: rows are padded to 4 bytes, negative heights mean top-down storage
+    int32_t height = image->infoHeader->biHeight;
+    if (image->infoHeader->biWidth <= 0 || height == 0 || height == INT32_MIN) {
+        fprintf(stderr, ERR_INVALID_BMP " (Invalid dimensions)\n");
+        free_bmp_image(image);
+        return NULL;
+    }
+    image->width = (uint32_t)image->infoHeader->biWidth;
+    image->top_down = height < 0;
+    image->height = (uint32_t)(height < 0 ? -height : height);
+    image->row_stride = ((size_t)image->width * image->bytes_per_pixel + 3) & ~(size_t)3;
+
+    // Reject geometries whose pixel array size does not fit in size_t
+    if (image->row_stride > SIZE_MAX / image->height) {
+        fprintf(stderr, ERR_INVALID_BMP " (Image too large for this platform)\n");
+        free_bmp_image(image);
+        return NULL;
+    }
+
+    // The whole pixel array must lie inside the file (the last row may omit its padding);
+    // a streamed carrier is checked as its rows arrive
+    size_t min_offset = sizeof(BMPFileHeader) + image->infoHeader->biSize;
+    if (image->infoHeader->biCompression == BI_BITFIELDS && image->infoHeader->biSize == sizeof(BMPInfoHeader)) {
+        min_offset += 3 * sizeof(uint32_t);
+    }
+    size_t pixel_bytes = (size_t)(image->height - 1) * image->row_stride + (size_t)image->width * image->bytes_per_pixel;
+    if (image->in_streamed && pixel_bytes <= SIZE_MAX - image->in_size) {
+        image->in_size += pixel_bytes;
+    }
+    if (image->fileHeader->bfOffBits < min_offset ||
+        image->fileHeader->bfOffBits > image->in_size ||
+        pixel_bytes > image->in_size - image->fileHeader->bfOffBits) {
+        fprintf(stderr, ERR_INVALID_BMP " (Truncated pixel data)\n");
+        free_bmp_image(image);
+        return NULL;
+    }
+
+    if (!image->in_streamed) {
+        image->data = (Pixel *)(image->in_map + image->fileHeader->bfOffBits);
+    }
+
     return image;
 }
 
-BMPImage * close_bmp(BMPImage *image){
-    if (!image || !image->out) {
-        fprintf(stderr, "Invalid image or output file\n");
+int load_bmp_pixels(BMPImage *image, size_t pixel_count) {
+    if (!image || !image->in_map) {
+        fprintf(stderr, ERR_INVALID_BMP);
+        return -1;
+    }
+    if (!image->in_streamed) {
+        return 0;
+    }
+
+    // Whole rows, the last one possibly without its padding
+    size_t rows = pixel_count / image->width + (pixel_count % image->width != 0);
+    if (rows > image->height) {
+        rows = image->height;
+    }
+    size_t end = image->fileHeader->bfOffBits + rows * image->row_stride;
+    if (end > image->in_size) {
+        end = image->in_size;
+    }
+    if (end <= image->in_loaded) {
+        return 0;
+    }
+
+    unsigned char *grown = realloc(image->in_map, end - image->in_dropped);
+    if (!grown) {
+        fprintf(stderr, "Error: Failed to allocate memory for the carrier rows.\n");
+        return -1;
+    }
+    image->in_map = grown;
+    image->data = (Pixel *)(image->in_map + image->fileHeader->bfOffBits);
+
+    size_t len = end - image->in_loaded;
+    if (read_full_fd(image->in_fd, image->in_map + image->in_loaded - image->in_dropped, len) != (ssize_t)len) {
+        fprintf(stderr, ERR_INVALID_BMP " (Truncated pixel data)\n");
+        return -1;
+    }
+    image->in_loaded = end;
+    return 0;
+}
+
+int release_bmp_pixels(BMPImage *image, size_t pixel_idx) {
+    if (!image || !image->in_streamed || !image->data || image->width == 0) {
+        return 0;
+    }
+
+    // Whole rows only: the one holding pixel_idx stays, and so does a last row without its padding
+    size_t header_size = image->fileHeader->bfOffBits;
+    size_t whole_rows = (image->in_size - header_size) / image->row_stride;
+    size_t row = pixel_idx / image->width;
+    size_t drop = (row < whole_rows ? row : whole_rows) * image->row_stride;
+    if (drop <= image->in_dropped) {
+        return 0;
+    }
+
+    size_t loaded = image->in_loaded - header_size;
+    size_t kept = loaded > drop ? loaded - drop : 0;
+    if (kept > 0) {
+        memmove(image->in_map + header_size, image->in_map + header_size + (drop - image->in_dropped), kept);
+    }
+    image->in_dropped = drop;
+    unsigned char *shrunk = realloc(image->in_map, header_size + kept);
+    if (shrunk) {
+        image->in_map = shrunk;
+    }
+    image->data = (Pixel *)(image->in_map + header_size);
+
+    // Rows not read yet are read and thrown away, so the next load starts after them
+    if (loaded < drop) {
+        unsigned char block[SKIP_BLOCK_SIZE];
+        size_t len = drop - loaded;
+        while (len > 0) {
+            size_t n = len < sizeof(block) ? len : sizeof(block);
+            if (read_full_fd(image->in_fd, block, n) != (ssize_t)n) {
+                fprintf(stderr, ERR_INVALID_BMP " (Truncated pixel data)\n");
+                return -1;
+            }
+            len -= n;
+        }
+        image->in_loaded = header_size + drop;
+    }
+    return 0;
+}
+
+size_t get_loaded_pixel_count(const BMPImage *image) {
+    if (!image->data || image->width == 0) {
+        return 0;
+    }
+    if (!image->in_streamed) {
+        return (size_t)image->width * image->height;
+    }
+    // Whole rows, the last one of the array possibly without its padding
+    size_t loaded = image->in_loaded - image->fileHeader->bfOffBits;
+    return (loaded + image->row_stride - 1) / image->row_stride * image->width;
+}
+
+BMPImage * open_output_bmp(BMPImage *image, const char *bmp_out, int clone) {
+    if (!image || !image->in_map) {
+        fprintf(stderr, ERR_INVALID_BMP);
         return NULL;
     }
-    
-    // Write headers to output file
-    if (fwrite(image->fileHeader, sizeof(BMPFileHeader), 1, image->out) != 1) {
-        fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
+
+    // stdout, or the output of a streamed carrier, is written front to back by write_bmp_rows
+    int to_stdout = strcmp(bmp_out, STDIO_PATH) == 0;
+    if (to_stdout || image->in_streamed) {
+        if (clone) {
+            fprintf(stderr, "Warning: Reflink clone not available when streaming, writing a full copy.\n");
+        }
+        int fd = to_stdout ? dup(STDOUT_FILENO) : open(bmp_out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(bmp_out);
+            return NULL;
+        }
+        image->out_fd = fd;
+        image->out_streamed = 1;
+        image->out_map = NULL;
+        image->out_size = 0;
+        return image;
+    }
+
+    int fd = open(bmp_out, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(bmp_out);
         return NULL;
     }
-    
-    if (fwrite(image->infoHeader, sizeof(BMPInfoHeader), 1, image->out) != 1) {
-        fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
+
+    // Reflink mode: the output shares the carrier's extents, only modified pages get rewritten
+    if (clone) {
+#ifdef FICLONE
+        if (image->in_mapped && ioctl(fd, FICLONE, image->in_fd) == 0) {
+            image->out_fd = fd;
+            image->out_cloned = 1;
+            image->out_map = NULL;  // Window over the modified prefix, set by copy_bmp_passthrough
+            image->out_size = 0;
+            return image;
+        }
+#endif
+        fprintf(stderr, "Warning: Reflink clone not supported for '%s', falling back to a full copy.\n", bmp_out);
+    }
+
+    // Pre-size the output so it can be mapped as a whole
+    if (ftruncate(fd, (off_t)image->in_size) != 0) {
+        perror(bmp_out);
+        close(fd);
         return NULL;
     }
 
-    // Write pixel data if available
-    if (image->data) {
-        // Calculate number of pixels
-        size_t pixel_count = get_pixel_count(image);
-        if (pixel_count > 0) {
-            if (fwrite(image->data, sizeof(Pixel), pixel_count, image->out) != pixel_count) {
-                fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
-                return NULL;
+    // Pipeline engines read the carrier back from its descriptor, so they need a real file
+    if (image->io_engine != BMP_IO_MMAP && image->in_mapped) {
+        image->out_fd = fd;
+        image->out_map = NULL;
+        image->out_size = 0;
+        return image;
+    }
+
+    void *map = mmap(NULL, image->in_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror(bmp_out);
+        close(fd);
+        return NULL;
+    }
+
+    // Content is filled in by copy_bmp_passthrough once the modified range is known
+    image->out_fd = fd;
+    image->out_map = map;
+    image->out_size = image->in_size;
+
+    return image;
+}
+
+/**
+ * @brief Copies [offset, offset + len) of the carrier into the output without going through user space.
+ * Tries copy_file_range, then sendfile, then falls back to large blocks: memcpy into the
+ * output mapping, or pwrite from the carrier mapping when the output is not mapped.
+ * @return 0 on success, -1 on write error.
+ */
+static int bulk_copy_range(BMPImage *image, size_t offset, size_t len) {
+#ifdef __linux__
+    if (image->in_mapped) {
+        off_t in_off = (off_t)offset;
+        off_t out_off = (off_t)offset;
+        while (len > 0) {
+            ssize_t n = copy_file_range(image->in_fd, &in_off, image->out_fd, &out_off, len, 0);
+            if (n <= 0) break;
+            len -= (size_t)n;
+        }
+        offset = (size_t)in_off;
+
+        if (len > 0 && lseek(image->out_fd, (off_t)offset, SEEK_SET) == (off_t)offset) {
+            while (len > 0) {
+                ssize_t n = sendfile(image->out_fd, image->in_fd, &in_off, len);
+                if (n <= 0) break;
+                len -= (size_t)n;
+            }
+            offset = (size_t)in_off;
+        }
+    }
+#endif
+
+    // Large-block fallback: a plain memcpy when the output is mapped
+    while (len > 0) {
+        size_t block = len < PASSTHROUGH_BLOCK_SIZE ? len : PASSTHROUGH_BLOCK_SIZE;
+        if (image->out_map) {
+            memcpy(image->out_map + offset, image->in_map + offset, block);
+        } else {
+            ssize_t n = pwrite(image->out_fd, image->in_map + offset, block, (off_t)offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -1;
             }
+            block = (size_t)n;
+        }
+        offset += block;
+        len -= block;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Writes back the pages of the cloned output window that differ from the carrier.
+ * @return 0 on success, -1 on write error.
+ */
+static int write_modified_pages(BMPImage *image) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t offset = 0;
+
+    while (offset < image->out_size) {
+        // Skip pages that still match the carrier (they are already shared with it)
+        size_t len = image->out_size - offset < page ? image->out_size - offset : page;
+        if (memcmp(image->out_map + offset, image->in_map + offset, len) == 0) {
+            offset += len;
+            continue;
+        }
+
+        // Coalesce the run of modified pages into a single pwrite
+        size_t run_end = offset + len;
+        while (run_end < image->out_size) {
+            size_t next = image->out_size - run_end < page ? image->out_size - run_end : page;
+            if (memcmp(image->out_map + run_end, image->in_map + run_end, next) == 0) break;
+            run_end += next;
+        }
+
+        while (offset < run_end) {
+            ssize_t n = pwrite(image->out_fd, image->out_map + offset, run_end - offset, (off_t)offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            offset += (size_t)n;
+        }
+    }
+
+    return 0;
+}
+
+int copy_bmp_passthrough(BMPImage *image, size_t modified_pixels) {
+    if (!image || image->out_fd < 0 || !image->in_map || (!image->out_map && !image->out_cloned)) {
+        fprintf(stderr, "Invalid image or output file\n");
+        return -1;
+    }
+
+    // File offset right after the last pixel that can change
+    size_t total_pixels = (size_t)image->width * image->height;
+    size_t split = image->in_size;
+    if (modified_pixels < total_pixels) {
+        split = image->fileHeader->bfOffBits
+                + (modified_pixels / image->width) * image->row_stride
+                + (modified_pixels % image->width) * image->bytes_per_pixel;
+    }
+
+    // Round up to a page so the bulk copy never shares a page with the in-place edits
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    split = (split + page - 1) / page * page;
+    if (split > image->in_size) {
+        split = image->in_size;
+    }
+
+    // Cloned output already holds the carrier: edit a private copy of the prefix instead
+    if (image->out_cloned) {
+        image->out_map = malloc(split);
+        if (!image->out_map) {
+            fprintf(stderr, "Error: Failed to allocate memory for the output window.\n");
+            return -1;
+        }
+        memcpy(image->out_map, image->in_map, split);
+        image->out_size = split;
+        image->data = (Pixel *)(image->out_map + image->fileHeader->bfOffBits);
+        return 0;
+    }
+
+    // Headers and the modified prefix go through memory: those pages are written anyway
+    memcpy(image->out_map, image->in_map, split);
+    image->data = (Pixel *)(image->out_map + image->fileHeader->bfOffBits);
+
+    // Untouched pixels and any trailing bytes are copied in bulk
+    return bulk_copy_range(image, split, image->in_size - split);
+}
+
+/**
+ * @brief Copies the carrier from offset to its end into a streamed output.
+ * A streamed carrier is read until end of file, so trailing bytes after the pixel array
+ * come along; it must at least reach the end of the pixel array.
+ * @return 0 on success, -1 on error (printed).
+ */
+static int stream_bmp_rest(BMPImage *image, size_t offset) {
+    if (!image->in_streamed) {
+        size_t len = image->in_size - offset;
+#ifdef __linux__
+        // Kernel-side copy: the untouched rest of the carrier never gets faulted into the mapping
+        off_t in_off = (off_t)offset;
+        while (len > 0) {
+            ssize_t n = sendfile(image->out_fd, image->in_fd, &in_off, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            len -= (size_t)n;
+        }
+        offset = (size_t)in_off;
+#endif
+        return write_full_fd(image->out_fd, image->in_map + offset, len);
+    }
+
+    unsigned char *block = malloc(PASSTHROUGH_BLOCK_SIZE);
+    if (!block) {
+        fprintf(stderr, "Error: Failed to allocate memory for the output copy.\n");
+        return -1;
+    }
+
+    ssize_t n;
+    while ((n = read_full_fd(image->in_fd, block, PASSTHROUGH_BLOCK_SIZE)) > 0) {
+        if (write_full_fd(image->out_fd, block, (size_t)n) != 0) {
+            n = -1;
+            break;
+        }
+        offset += (size_t)n;
+    }
+    free(block);
+
+    if (n == 0 && offset < image->in_size) {
+        fprintf(stderr, ERR_INVALID_BMP " (Truncated pixel data)\n");
+        return -1;
+    }
+    return n == 0 ? 0 : -1;
+}
+
+/**
+ * @brief write_bmp_rows for a streamed output: headers, modified rows and rest, in file order.
+ * Rows already loaded from a streamed carrier are edited in place, anything else goes
+ * through the row pipeline (sequential reads and writes, see bmp_io.h).
+ * @return 0 on success, -1 on error.
+ */
+static int stream_bmp_rows(BMPImage *image, uint32_t row_count, bmp_span_callback_t callback, void *ctx, size_t ctx_size) {
+    size_t header_size = image->fileHeader->bfOffBits;
+
+    if (image->in_streamed && image->in_loaded > header_size) {
+        if (load_bmp_pixels(image, (size_t)row_count * image->width) != 0 ||
+            parallel_bmp_rows(image, image->in_map + header_size, 0, row_count, callback, ctx, ctx_size, NULL) != 0 ||
+            write_full_fd(image->out_fd, image->in_map, image->in_loaded) != 0) {
+            return -1;
+        }
+        return stream_bmp_rest(image, image->in_loaded);
+    }
+
+    size_t rows_end = header_size + (size_t)row_count * image->row_stride;
+    if (rows_end > image->in_size) {
+        rows_end = image->in_size;
+    }
+    if (write_full_fd(image->out_fd, image->in_map, header_size) != 0 ||
+        pipeline_bmp_rows(image, row_count, callback, ctx, ctx_size) != 0) {
+        return -1;
+    }
+    return stream_bmp_rest(image, rows_end);
+}
+
+int write_bmp_rows(BMPImage *image, size_t modified_pixels, bmp_span_callback_t callback, void *ctx, size_t ctx_size) {
+    if (!image || image->out_fd < 0 || !image->in_map) {
+        fprintf(stderr, "Invalid image or output file\n");
+        return -1;
+    }
+
+    // Only the rows holding modified pixels are visited
+    size_t rows = modified_pixels / image->width + (modified_pixels % image->width != 0);
+    uint32_t row_count = rows < image->height ? (uint32_t)rows : image->height;
+
+    if (image->out_streamed) {
+        return stream_bmp_rows(image, row_count, callback, ctx, ctx_size);
+    }
+
+    // Mapped (or cloned) output: edit the pixels in place
+    if (image->out_map || image->out_cloned) {
+        if (copy_bmp_passthrough(image, modified_pixels) != 0) {
+            return -1;
         }
+        return parallel_bmp_rows(image, (unsigned char *)image->data, 0, row_count, callback, ctx, ctx_size, NULL);
+    }
+
+    // Pipelined output: headers, then the modified rows in flight, then the untouched rest
+    size_t rows_end = image->fileHeader->bfOffBits + (size_t)row_count * image->row_stride;
+    if (rows_end > image->in_size) {
+        rows_end = image->in_size;
     }
-    
-    if (fclose(image->out) != 0) {
+
+    if (bulk_copy_range(image, 0, image->fileHeader->bfOffBits) != 0 ||
+        pipeline_bmp_rows(image, row_count, callback, ctx, ctx_size) != 0 ||
+        bulk_copy_range(image, rows_end, image->in_size - rows_end) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+BMPImage * close_bmp(BMPImage *image){
+    if (!image || image->out_fd < 0) {
+        fprintf(stderr, "Invalid image or output file\n");
+        return NULL;
+    }
+
+    image->data = image->in_streamed && image->in_loaded <= image->fileHeader->bfOffBits
+                  ? NULL : (Pixel *)(image->in_map + image->fileHeader->bfOffBits);
+
+    if (image->out_cloned) {
+        int written = image->out_map ? write_modified_pages(image) : 0;
+        free(image->out_map);
+        image->out_map = NULL;
+        if (written != 0) {
+            fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
+            return NULL;
+        }
+    } else if (image->out_map && munmap(image->out_map, image->out_size) != 0) {
+        fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
+        image->out_map = NULL;
+        return NULL;
+    }
+    image->out_map = NULL;
+
+    if (close(image->out_fd) != 0) {
         fprintf(stderr, ERR_FAILED_TO_CLOSE_BMP);
+        image->out_fd = -1;
         return NULL;
     }
-    
-    image->out = NULL;
+
+    image->out_fd = -1;
     return image;
 }
 
-int get_pixel_count(const BMPImage *image) {
+int64_t get_pixel_count(const BMPImage *image) {
     if (!image || !image->infoHeader) {
         return -1;
     }
-    
-    return image->infoHeader->biWidth * image->infoHeader->biHeight;
+
+    return (int64_t)image->width * image->height;
 }
 
 void free_bmp_image(BMPImage *image) {
     if (!image) return;
-    
+
     if (image->fileHeader) {
         free(image->fileHeader);
         image->fileHeader = NULL;
     }
-    
+
     if (image->infoHeader) {
         free(image->infoHeader);
         image->infoHeader = NULL;
     }
-    
-    if (image->data) {
-        free(image->data);
-        image->data = NULL;
+
+    // data always points into one of the mappings below
+    image->data = NULL;
+
+    if (image->out_map) {
+        if (image->out_cloned) {
+            free(image->out_map);
+        } else {
+            munmap(image->out_map, image->out_size);
+        }
+        image->out_map = NULL;
+    }
+
+    if (image->out_fd >= 0) {
+        close(image->out_fd);
+        image->out_fd = -1;
     }
-    
-    if (image->in) {
-        fclose(image->in);
-        image->in = NULL;
+
+    if (image->in_map) {
+        if (image->in_mapped) {
+            munmap(image->in_map, image->in_size);
+        } else {
+            free(image->in_map);
+        }
+        image->in_map = NULL;
     }
-    
-    if (image->out) {
-        fclose(image->out);
-        image->out = NULL;
+
+    if (image->in_fd >= 0) {
+        close(image->in_fd);
+        image->in_fd = -1;
     }
-    
+
     free(image);
-}
\ No newline at end of file
+}
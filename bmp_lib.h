@@ -29,43 +29,182 @@ typedef struct {
     uint32_t biClrImportant;  // Number of important colors
 } __attribute__((packed)) BMPInfoHeader;
 
-// Pixel structure (RGB)
+// Pixel structure (RGB). In 32-bit images it overlays the first 3 bytes of each BGRA pixel.
 typedef struct {
     unsigned char blue;
     unsigned char green;
     unsigned char red;
 } __attribute__((packed)) Pixel;
 
+// How the embedding moves pixel rows between the carrier and the output
+typedef enum {
+    BMP_IO_MMAP = 0,            // Edit a shared mapping of the output (default)
+    BMP_IO_URING,               // Double-buffered pipeline over io_uring (falls back to BMP_IO_THREADS)
+    BMP_IO_THREADS              // Double-buffered pipeline with reader/writer threads
+} BMPIOEngine;
+
 // BMP Image structure
 typedef struct {
     BMPFileHeader * fileHeader;
     BMPInfoHeader * infoHeader;
-    Pixel * data;
-    FILE * in;
-    FILE * out;
+    Pixel * data;               // Pixel array: points into the output once copy_bmp_passthrough ran, into the carrier otherwise
+    unsigned char * in_map;     // Read-only mapping of the whole carrier file (streamed carrier: its headers, then the rows read and not dropped)
+    size_t in_size;             // Size of the carrier file in bytes (streamed carrier: end of the pixel array)
+    int in_fd;                  // Carrier file descriptor (-1 if closed)
+    int in_mapped;              // 1 if in_map is an mmap of the whole carrier, 0 if the carrier is streamed (in_streamed)
+    int in_streamed;            // 1 if the carrier is a pipe read front to back from in_fd
+    size_t in_loaded;           // Streamed carrier: bytes read from in_fd so far (headers, then rows)
+    size_t in_dropped;          // Streamed carrier: pixel array bytes dropped from the front by release_bmp_pixels
+    unsigned char * out_map;    // Shared mapping of the output file (same size as the carrier)
+    size_t out_size;            // Size of out_map in bytes
+    int out_fd;                 // Output file descriptor (-1 if none)
+    int out_cloned;             // 1 if the output is a reflink clone of the carrier (out_map is then a heap window)
+    int out_streamed;           // 1 if the output is written front to back (stdout, or a streamed carrier)
+    uint32_t width;             // Width in pixels
+    uint32_t height;            // Height in pixels (absolute value of biHeight)
+    int top_down;               // 1 if biHeight is negative (first stored row is the top one)
+    size_t row_stride;          // Bytes per stored row, including the padding to a 4-byte boundary
+    size_t bytes_per_pixel;     // 3 for 24-bit BGR, 4 for 32-bit BGRA (alpha is never modified)
+    BMPIOEngine io_engine;      // Engine used by write_bmp_rows (set before open_output_bmp)
+    unsigned int threads;       // Worker threads for write_bmp_rows and extraction (1 = the calling thread only)
 } BMPImage;
 
+/**
+ * @brief Contiguous run of pixels inside a single row of the pixel array.
+ * Spans never include the row padding, so pixels[0..pixel_count) is always valid.
+ */
+typedef struct {
+    unsigned char * pixels;     // First byte of the first pixel of the span
+    size_t pixel_count;         // Number of pixels in the span
+    size_t pixel_stride;        // Bytes between consecutive pixels (BGR_PIXEL_SIZE or BGRA_PIXEL_SIZE)
+    size_t stride;              // Bytes between the start of consecutive stored rows
+    uint32_t row;               // Logical row of the span (0 = top of the image)
+    uint32_t column;            // Column of the first pixel of the span
+    size_t first_pixel;         // Storage-order index of the first pixel (padding excluded)
+} BMPSpan;
+
+typedef void (*bmp_span_callback_t)(const BMPSpan *span, void *ctx);
+
 // Constants
 #define HEADER_SIZE 54
+#define BGR_PIXEL_SIZE 3      // 24-bit pixels
+#define BGRA_PIXEL_SIZE 4     // 32-bit pixels
+#define BI_RGB 0
+#define BI_BITFIELDS 3
+#define PASSTHROUGH_BLOCK_SIZE (8 * 1024 * 1024) // Block size of the user-space copy fallback
+#define SKIP_BLOCK_SIZE (64 * 1024)  // Block size of the rows release_bmp_pixels reads and discards
+#define STDIO_PATH "-"          // File name standing for stdin (-in, -p) or stdout (-out)
+#define MAX_STREAM_HEADER_SIZE (1024 * 1024) // Largest bfOffBits accepted from a streamed carrier
 
 // Function prototypes
 
 /**
  * @brief Opens a BMP file and initializes the BMPImage structure
+ * The carrier is mapped read-only and image->data points at its pixel array.
+ * STDIO_PATH reads the carrier from stdin. A carrier that cannot be mapped (pipe) is
+ * streamed: only its headers are read here and image->data stays NULL until
+ * load_bmp_pixels reads the rows that are needed; write_bmp_rows reads the rest.
+ * Accepts BITMAPINFOHEADER and the larger V4/V5 headers, with either 24-bit BI_RGB
+ * pixels or 32-bit BGRA pixels (BI_RGB or BI_BITFIELDS with the standard masks).
  * @param bmp_in Path to the input BMP file
  * @return Pointer to initialized BMPImage structure, NULL on error
  */
 BMPImage * open_bmp(const char *bmp_in);
 
 /**
- * @brief Closes a BMP file and writes the final output
+ * @brief Reads the first pixel_count pixels of a streamed carrier into memory
+ * Whole rows are appended to image->in_map and image->data points at them; only those
+ * rows may be accessed until the rest is loaded. No-op for mapped carriers and for rows
+ * already loaded.
+ * @param image Pointer to an opened BMPImage structure
+ * @param pixel_count Number of pixels (storage order) that must be in memory
+ * @return 0 on success, -1 on error (truncated carrier or out of memory)
+ */
+int load_bmp_pixels(BMPImage *image, size_t pixel_count);
+
+/**
+ * @brief Drops the rows of a streamed carrier that come before the one holding pixel_idx
+ * Those pixels can no longer be accessed (get_pixel returns NULL), so memory only holds the
+ * rows from there on; rows not loaded yet are read from the pipe and discarded. For readers
+ * that move forward only: the embed writes the loaded rows out as they are. No-op for
+ * mapped carriers.
+ * @param image Pointer to an opened BMPImage structure
+ * @param pixel_idx First pixel (storage order) still needed
+ * @return 0 on success, -1 on error (truncated carrier)
+ */
+int release_bmp_pixels(BMPImage *image, size_t pixel_idx);
+
+/**
+ * @brief Number of pixels (storage order) up to the last one image->data holds: the whole
+ * pixel array of a mapped carrier, the rows read so far of a streamed one (load_bmp_pixels).
+ * @param image Pointer to an opened BMPImage structure
+ * @return Pixel count, 0 if no row is in memory
+ */
+size_t get_loaded_pixel_count(const BMPImage *image);
+
+/**
+ * @brief Creates the output BMP as a pre-sized shared mapping
+ * Once copy_bmp_passthrough runs, image->data points into the output mapping, so every
+ * change made to the pixels lands directly in the output file (no per-pixel I/O).
+ * With the pipeline engines (image->io_engine) the output is only pre-sized, not mapped:
+ * write_bmp_rows streams it through its own buffers.
+ * With clone set, the output is first made a reflink (FICLONE) of the carrier; only the
+ * pages that end up holding payload bits are rewritten (pwrite) by close_bmp. Falls back
+ * to the regular full copy when the filesystem does not support cloning.
+ * STDIO_PATH writes the output to stdout. Such an output, or any output of a streamed
+ * carrier, is written front to back by write_bmp_rows (no mapping, no clone).
+ * @param image Pointer to an opened BMPImage structure
+ * @param bmp_out Path to the output BMP file
+ * @param clone 1 to try a reflink clone of the carrier, 0 for a regular copy
+ * @return Pointer to BMPImage structure, NULL on error
+ */
+BMPImage * open_output_bmp(BMPImage *image, const char *bmp_out, int clone);
+
+/**
+ * @brief Fills the output with the carrier, leaving the first modified_pixels pixels ready to edit
+ * Headers and the pixels that may change are copied through memory; everything after
+ * them (untouched pixels, padding and trailing bytes) is copied kernel-side with
+ * copy_file_range/sendfile, or in large blocks when those are not available.
+ * Must be called once, after open_output_bmp and before modifying image->data.
+ * @param image Pointer to BMPImage structure with an open output
+ * @param modified_pixels Number of pixels (storage order) the embedding may modify
+ * @return 0 on success, -1 on error
+ */
+int copy_bmp_passthrough(BMPImage *image, size_t modified_pixels);
+
+/**
+ * @brief Writes the whole output, passing the first modified_pixels pixels through callback
+ * The rows holding those pixels are visited in storage order, as in iterate_bmp_rows,
+ * and everything else is copied from the carrier untouched. With BMP_IO_MMAP (or a
+ * cloned output) this is copy_bmp_passthrough plus an in-place walk of the mapping;
+ * with the pipeline engines the rows are read, modified and written in large blocks
+ * that stay in flight concurrently (see bmp_io.h). A streamed output gets the same
+ * pipeline, written front to back, unless the carrier rows are already in memory
+ * (load_bmp_pixels): those are then edited in place and written as they are.
+ * When ctx_size is not 0 the callback must position itself from each span (first_pixel)
+ * instead of relying on having seen the previous rows: the rows are then split among
+ * image->threads workers (see parallel_bmp_rows), each with its own copy of *ctx, and
+ * *ctx ends up as the copy that processed the last rows.
+ * Must be called once, after open_output_bmp.
+ * @param image Pointer to BMPImage structure with an open output
+ * @param modified_pixels Number of pixels (storage order) the embedding may modify
+ * @param callback Function called once per row span
+ * @param ctx Context pointer passed to callback function
+ * @param ctx_size Size of *ctx for a parallel walk, 0 to visit every row on the calling thread
+ * @return 0 on success, -1 on error
+ */
+int write_bmp_rows(BMPImage *image, size_t modified_pixels, bmp_span_callback_t callback, void *ctx, size_t ctx_size);
+
+/**
+ * @brief Flushes and unmaps the output BMP file (writes back the modified pages of a cloned output)
  * @param image Pointer to BMPImage structure
  * @return Pointer to BMPImage structure, NULL on error
  */
 BMPImage * close_bmp(BMPImage *image);
 
 /**
- * @brief Processes a BMP file pixel by pixel using a callback function
+ * @brief Processes the pixel array of a BMP in memory pixel by pixel using a callback function
+ * The callback modifies image->data in place (the output mapping when embedding).
  * @param image Pointer to BMPImage structure
  * @param callback Function pointer to process each pixel
  * @param ctx Context pointer passed to callback function
@@ -74,6 +213,48 @@ void iterate_bmp(BMPImage *image,
     void (*callback)(Pixel *byte, void *ctx),
     void *ctx);
 
+/**
+ * @brief Processes the pixel array row by row using a callback function
+ * Rows are visited in storage order; padding bytes are skipped and BMPSpan.row
+ * holds the logical row, so both bottom-up and top-down images are handled.
+ * @param image Pointer to BMPImage structure
+ * @param callback Function called once per row
+ * @param ctx Context pointer passed to callback function
+ */
+void iterate_bmp_rows(BMPImage *image, bmp_span_callback_t callback, void *ctx);
+
+/**
+ * @brief Processes the pixel array in spans of at most max_span_pixels pixels
+ * Same order and padding rules as iterate_bmp_rows; a span never crosses a row.
+ * @param image Pointer to BMPImage structure
+ * @param max_span_pixels Maximum pixels per span (0 = whole rows)
+ * @param callback Function called once per span
+ * @param ctx Context pointer passed to callback function
+ */
+void iterate_bmp_spans(BMPImage *image, size_t max_span_pixels, bmp_span_callback_t callback, void *ctx);
+
+/**
+ * @brief Processes row_count stored rows held in a caller buffer instead of image->data
+ * The buffer holds the rows starting at storage row first_row, row_stride bytes apart;
+ * spans are reported exactly as iterate_bmp_rows would report them for those rows.
+ * @param image Pointer to BMPImage structure (geometry only)
+ * @param buffer First byte of stored row first_row
+ * @param first_row Storage index of the first row in the buffer
+ * @param row_count Number of rows in the buffer
+ * @param callback Function called once per row
+ * @param ctx Context pointer passed to callback function
+ */
+void iterate_bmp_buffer_rows(const BMPImage *image, unsigned char *buffer, uint32_t first_row, uint32_t row_count,
+                             bmp_span_callback_t callback, void *ctx);
+
+/**
+ * @brief Returns the address of a pixel given its storage-order index (padding excluded)
+ * @param image Pointer to BMPImage structure
+ * @param pixel_idx Index of the pixel, 0 being the first stored pixel
+ * @return Pointer to the pixel inside image->data, NULL if out of range (or not loaded, or released)
+ */
+Pixel * get_pixel(const BMPImage *image, size_t pixel_idx);
+
 /**
  * @brief Frees memory allocated for BMPImage structure
  * @param image Pointer to BMPImage structure to free
@@ -83,10 +264,11 @@ void free_bmp_image(BMPImage *image);
 
 /**
  * @brief Gets the total number of pixels in the BMP image
+ * Computed in 64 bits: gigapixel carriers overflow an int.
  * @param image Pointer to BMPImage structure
  * @return Number of pixels, -1 on error
  */
-int get_pixel_count(const BMPImage *image);
+int64_t get_pixel_count(const BMPImage *image);
 
 
 #endif // BMP_LIB_H
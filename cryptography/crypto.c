@@ -53,93 +53,95 @@ int derive_key_iv_pbkdf2(const char *password, const EVP_CIPHER *cipher, unsigne
     return 0;
 }
 
-unsigned char *encrypt_data(const unsigned char *plaintext, int plaintext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int *ciphertext_len) {
-    EVP_CIPHER_CTX *ctx; // encryption operation current state
-    int len;
-    int ct_len;
-
-    // output buffer size: block size for padding
-    unsigned char *ciphertext = malloc(plaintext_len + EVP_CIPHER_block_size(cipher));
-    if (!ciphertext)
-        return NULL;
+int decrypt_prefix(const unsigned char *ciphertext, int ciphertext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, unsigned char *plaintext) {
+    EVP_CIPHER_CTX *ctx;
+    int len = -1;
 
     if (!((ctx = EVP_CIPHER_CTX_new()))) {
-        ERR_print_errors_fp(stderr);
-        free(ciphertext);
-        return NULL;
+        return -1;
     }
 
-    // initialize encryption operation via context
-    if (1 != EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv)) {
-        ERR_print_errors_fp(stderr);
-        EVP_CIPHER_CTX_free(ctx);
-        free(ciphertext);
-        return NULL;
+    // No padding: the last whole block is returned by the update instead of being held back
+    if (1 != EVP_DecryptInit_ex(ctx, cipher, NULL, key, iv) ||
+        1 != EVP_CIPHER_CTX_set_padding(ctx, 0) ||
+        1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len)) {
+        len = -1;
     }
 
-    // encrypt
-    if (1 != EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, plaintext_len)) {
-        ERR_print_errors_fp(stderr);
-        EVP_CIPHER_CTX_free(ctx);
-        free(ciphertext);
-        return NULL;
-    }
-    ct_len = len;
+    EVP_CIPHER_CTX_free(ctx);
+    return len;
+}
 
-    // finalize encryption
-    if (1 != EVP_EncryptFinal_ex(ctx, ciphertext + len, &len)) {
-        ERR_print_errors_fp(stderr);
-        EVP_CIPHER_CTX_free(ctx);
-        free(ciphertext);
-        return NULL;
+int decrypt_at(const unsigned char *ciphertext, int ciphertext_len, uint64_t offset, const unsigned char *previous,
+               const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, unsigned char *plaintext) {
+    if (offset == 0 || EVP_CIPHER_mode(cipher) == EVP_CIPH_ECB_MODE) {
+        return decrypt_prefix(ciphertext, ciphertext_len, cipher, key, iv, plaintext);
+    }
+    if (EVP_CIPHER_mode(cipher) != EVP_CIPH_OFB_MODE) {
+        return decrypt_prefix(ciphertext, ciphertext_len, cipher, key, previous, plaintext);
     }
-    ct_len += len;
 
-    *ciphertext_len = ct_len;
-    EVP_CIPHER_CTX_free(ctx);
-    return ciphertext;
+    // OFB: the keystream only depends on the IV. Run it over zeros up to offset, then XOR
+    // the ciphertext with what follows (encrypting and decrypting are the same operation)
+    unsigned char zeros[4096] = {0};
+    unsigned char discarded[sizeof(zeros) + EVP_MAX_BLOCK_LENGTH];
+    EVP_CIPHER_CTX *ctx = cipher_stream_begin(cipher, key, iv, 1);
+    int len = ctx ? 0 : -1;
+
+    while (len == 0 && offset > 0) {
+        int n = offset < sizeof(zeros) ? (int)offset : (int)sizeof(zeros);
+        if (cipher_stream_update(ctx, zeros, n, discarded) < 0) {
+            len = -1;
+        }
+        offset -= (uint64_t)n;
+    }
+    if (len == 0) {
+        len = cipher_stream_update(ctx, ciphertext, ciphertext_len, plaintext);
+    }
+    cipher_stream_free(ctx);
+    return len;
 }
 
-unsigned char *decrypt_data(const unsigned char *ciphertext, int ciphertext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int *plaintext_len) {
+EVP_CIPHER_CTX *cipher_stream_begin(const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int encrypt) {
     EVP_CIPHER_CTX *ctx;
-    int len;
-
-    // output buffer size: ciphertext_len (max) since padding is removed
-    unsigned char *plaintext = malloc(ciphertext_len);
-    if (!plaintext) return NULL;
 
     if (!((ctx = EVP_CIPHER_CTX_new()))) {
         ERR_print_errors_fp(stderr);
-        free(plaintext);
         return NULL;
     }
 
-    // initialize decryption operation
-    if (1 != EVP_DecryptInit_ex(ctx, cipher, NULL, key, iv)) {
+    if (1 != EVP_CipherInit_ex(ctx, cipher, NULL, key, iv, encrypt)) {
         ERR_print_errors_fp(stderr);
         EVP_CIPHER_CTX_free(ctx);
-        free(plaintext);
         return NULL;
     }
+    return ctx;
+}
+
+int cipher_stream_update(EVP_CIPHER_CTX *ctx, const unsigned char *in, int in_len, unsigned char *out) {
+    int len;
 
-    // decrypt
-    if (1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len)) {
+    if (1 != EVP_CipherUpdate(ctx, out, &len, in, in_len)) {
         ERR_print_errors_fp(stderr);
-        EVP_CIPHER_CTX_free(ctx);
-        free(plaintext);
-        return NULL;
+        return -1;
     }
-    int pt_len = len;
+    return len;
+}
 
-    if (1 != EVP_DecryptFinal_ex(ctx, plaintext + len, &len)) {
-        fprintf(stderr, "Error: Decryption failed. Possible wrong password or corrupted data.\n");
-        EVP_CIPHER_CTX_free(ctx);
-        free(plaintext);
-        return NULL;
+int cipher_stream_final(EVP_CIPHER_CTX *ctx, unsigned char *out) {
+    int len;
+
+    if (1 != EVP_CipherFinal_ex(ctx, out, &len)) {
+        if (EVP_CIPHER_CTX_encrypting(ctx)) {
+            ERR_print_errors_fp(stderr);
+        } else {
+            fprintf(stderr, "Error: Decryption failed. Possible wrong password or corrupted data.\n");
+        }
+        return -1;
     }
-    pt_len += len;
+    return len;
+}
 
-    *plaintext_len = pt_len;
+void cipher_stream_free(EVP_CIPHER_CTX *ctx) {
     EVP_CIPHER_CTX_free(ctx);
-    return plaintext;
-}
\ No newline at end of file
+}
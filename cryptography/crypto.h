@@ -3,6 +3,7 @@
 
 #include <openssl/evp.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // fixed salt as instructed
 // fixed salt as instructed (8 bytes of 0x00)
@@ -27,27 +28,70 @@ const EVP_CIPHER *get_evp_cipher(const char *algo, const char *mode);
 int derive_key_iv_pbkdf2(const char *password, const EVP_CIPHER *cipher, unsigned char *key_iv_buffer);
 
 /**
- * @brief Encrypts a data buffer.
- * * @param plaintext Buffer with data to be encrypted.
- * @param plaintext_len Length of the data.
+ * @brief Decrypts the first bytes of a ciphertext without finalizing (padding is not checked).
+ * In ECB, CBC, CFB and OFB a plaintext prefix only depends on the ciphertext prefix and the IV,
+ * so the start of a payload can be read without the rest of it.
+ * @param ciphertext First bytes of the ciphertext.
+ * @param ciphertext_len Number of bytes given.
  * @param cipher EVP cipher type.
  * @param key Pointer to the key.
  * @param iv Pointer to the IV.
- * @param ciphertext_len Pointer to store the length of the encrypted text (includes padding).
- * @return Pointer to the buffer with the encrypted data (must be freed by the caller) or NULL on error.
+ * @param plaintext Output buffer (at least ciphertext_len bytes).
+ * @return Number of plaintext bytes produced (whole blocks in ECB/CBC), or -1 on error.
  */
-unsigned char *encrypt_data(const unsigned char *plaintext, int plaintext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int *ciphertext_len);
+int decrypt_prefix(const unsigned char *ciphertext, int ciphertext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, unsigned char *plaintext);
 
 /**
- * @brief Decrypts a data buffer.
- * @param ciphertext Buffer with data to be decrypted.
- * @param ciphertext_len Length of the data to be decrypted.
+ * @brief Decrypts ciphertext bytes that start `offset` bytes into a ciphertext, without the
+ * bytes before them (padding is not checked). ECB and CBC offsets must be block-aligned.
+ * ECB needs nothing before offset; CBC and CFB chain from the IV-length ciphertext bytes
+ * right before it (previous); OFB runs its keystream from the IV up to offset, which costs
+ * cipher work but no ciphertext.
+ * @param ciphertext Ciphertext bytes from offset on.
+ * @param ciphertext_len Number of bytes given.
+ * @param offset Position of ciphertext[0] in the whole ciphertext.
+ * @param previous The IV-length ciphertext bytes before offset (CBC, CFB; unused at offset 0).
  * @param cipher EVP cipher type.
  * @param key Pointer to the key.
  * @param iv Pointer to the IV.
- * @param plaintext_len Pointer to store the length of the decrypted text.
- * @return Pointer to the buffer with the decrypted data (must be freed by the caller) or NULL on error.
+ * @param plaintext Output buffer (at least ciphertext_len bytes).
+ * @return Number of plaintext bytes produced, or -1 on error.
  */
-unsigned char *decrypt_data(const unsigned char *ciphertext, int ciphertext_len, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int *plaintext_len);
+int decrypt_at(const unsigned char *ciphertext, int ciphertext_len, uint64_t offset, const unsigned char *previous,
+               const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, unsigned char *plaintext);
+
+/**
+ * @brief Starts an incremental encryption or decryption, fed chunk by chunk with
+ * cipher_stream_update and closed with cipher_stream_final (PKCS#7 padding in ECB and CBC).
+ * @param cipher EVP cipher type.
+ * @param key Pointer to the key.
+ * @param iv Pointer to the IV.
+ * @param encrypt 1 to encrypt, 0 to decrypt.
+ * @return Cipher context (release with cipher_stream_free), or NULL on error.
+ */
+EVP_CIPHER_CTX *cipher_stream_begin(const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, int encrypt);
+
+/**
+ * @brief Runs the next chunk through the cipher.
+ * @param ctx Context from cipher_stream_begin.
+ * @param in Next input bytes.
+ * @param in_len Number of input bytes.
+ * @param out Output buffer (at least in_len + block size bytes).
+ * @return Number of bytes written to out (whole blocks may be held back), or -1 on error.
+ */
+int cipher_stream_update(EVP_CIPHER_CTX *ctx, const unsigned char *in, int in_len, unsigned char *out);
+
+/**
+ * @brief Flushes the last block: adds the padding when encrypting, checks and strips it when decrypting.
+ * @param ctx Context from cipher_stream_begin.
+ * @param out Output buffer (at least one block).
+ * @return Number of bytes written to out, or -1 on error (e.g. wrong password).
+ */
+int cipher_stream_final(EVP_CIPHER_CTX *ctx, unsigned char *out);
+
+/**
+ * @brief Releases a context from cipher_stream_begin (NULL is ignored).
+ */
+void cipher_stream_free(EVP_CIPHER_CTX *ctx);
 
 #endif // CRYPTO_H
\ No newline at end of file
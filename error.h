@@ -5,21 +5,29 @@
 #define ERR_IN_REQUIRES_FILENAME "Error: -in requires a filename\n"
 #define ERR_P_REQUIRES_BITMAP "Error: -p requires a bitmap filename\n"
 #define ERR_OUT_REQUIRES_BITMAP "Error: -out requires a bitmap filename\n"
-#define ERR_STEG_REQUIRES_ALGORITHM "Error: -steg requires an algorithm (LSB1, LSB4, or LSBI)\n"
+#define ERR_STEG_REQUIRES_ALGORITHM "Error: -steg requires an algorithm (LSB1, LSB2, LSB3, LSB4, or LSBI)\n"
 #define ERR_A_REQUIRES_ALGORITHM "Error: -a requires an algorithm (aes128, aes192, aes256, or 3des)\n"
 #define ERR_M_REQUIRES_MODE "Error: -m requires a mode (ecb, cfb, ofb, or cbc)\n"
 #define ERR_PASS_REQUIRES_PASSWORD "Error: -pass requires a password\n"
 #define ERR_UNKNOWN_OPTION "Error: Unknown option '%s'\n"
 
 // Error messages for argument validation
-#define ERR_FLAG_REQUIRED "Error: -embed or -extract flag is required\n"
+#define ERR_FLAG_REQUIRED "Error: -embed, -extract or -info flag is required\n"
 #define ERR_IN_PARAMETER_REQUIRED "Error: -in parameter is required\n"
 #define ERR_P_PARAMETER_REQUIRED "Error: -p parameter is required\n"
 #define ERR_OUT_PARAMETER_REQUIRED "Error: -out parameter is required\n"
 #define ERR_STEG_PARAMETER_REQUIRED "Error: -steg parameter is required\n"
-#define ERR_INVALID_STEG_ALGORITHM "Error: Invalid steganography algorithm '%s'. Must be LSB1, LSB4, or LSBI\n"
+#define ERR_INVALID_STEG_ALGORITHM "Error: Invalid steganography algorithm '%s'. Must be LSB1, LSB2, LSB3, LSB4, or LSBI\n"
+#define ERR_STEG_AUTO_EMBED "Error: -steg auto is only available for -extract and -info\n"
 #define ERR_INVALID_ENCRYPTION_ALGORITHM "Error: Invalid encryption algorithm '%s'. Must be aes128, aes192, aes256, or 3des\n"
 #define ERR_INVALID_MODE "Error: Invalid mode '%s'. Must be ecb, cfb, ofb, or cbc\n"
+#define ERR_INVALID_KERNEL "Error: Invalid kernel '%s'. Must be auto, scalar, sse, avx2, or avx512\n"
+#define ERR_INVALID_THREADS "Error: Invalid thread count. -threads must be between 1 and %d\n"
+#define ERR_INVALID_IO_ENGINE "Error: Invalid I/O engine '%s'. Must be mmap, uring, or threads\n"
+#define ERR_INVALID_RANGE "Error: -offset must be a non-negative byte offset and -length a positive byte count\n"
+#define ERR_RANGE_EXTRACT_ONLY "Error: -offset and -length are only available for -extract\n"
+#define ERR_RANGE_ENCRYPTED "Error: -offset and -length cannot be used with encrypted payloads\n"
+#define ERR_STDIN_TWICE "Error: -in and -p cannot both read from stdin ('-')\n"
 #define ERR_PASSWORD_REQUIRED_FOR_ENCRYPTION "Error: Password is required when encryption algorithm is specified\n"
 
 // General error messages
@@ -36,6 +44,7 @@
 
 // VALIDATE FILES errors messages
 #define ERR_INSUFFICIENT_CAPACITY "Error: Carrier BMP capacity is insufficient.\n"
+#define ERR_SECRET_READ "Error: Failed to read the secret file during embedding.\n"
 
 
 #endif // ERROR_H
@@ -1,7 +1,13 @@
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
 
 // Módulos del proyecto
 #include "handlers.h"
@@ -11,76 +17,336 @@
 #include "steganography/steganography.h"
 #include "cryptography/crypto.h"
 #include "steganography/extract_utils.h"
+#include "steganography/lsb_kernels.h"
+
+int select_kernels(const ProgramArgs *args) {
+    return lsb_kernels_select(args->kernel) == 0 ? SUCCESS : NO_SUCCESS;
+}
+
+FILE *status_stream(const ProgramArgs *args) {
+    return args->output_file && strcmp(args->output_file, STDIO_PATH) == 0 ? stderr : stdout;
+}
+
+#define ENCRYPT_PIECE_BYTES (64 * 1024) // Plaintext bytes encrypted per cipher update
+#define ENCRYPT_KEEP_BYTES 4096         // Ciphertext kept behind the newest piece (embed windows overlap slightly)
+
+/**
+ * @brief Embed payload of encrypted secrets: (ciphertext size || ciphertext), produced on
+ * demand from the plaintext source (real size || real data || ext) as the embed reaches it.
+ * The ciphertext size is known up front (see ciphertext_length), so only the newest piece
+ * of ciphertext is in memory. Reads must move forward; a read behind the kept ciphertext
+ * restarts the cipher from the first byte. Embeds that read out of order (LSBI's two passes,
+ * rows split over -threads) spill the whole ciphertext to a temporary file instead.
+ */
+typedef struct {
+    PayloadSource *plain;
+    const EVP_CIPHER *cipher;
+    unsigned char key_iv[KEY_IV_LEN];
+    EVP_CIPHER_CTX *cipher_ctx;
+    uint64_t plain_offset;          // Next plaintext byte to encrypt
+    int finished;                   // The cipher has been flushed (padding added)
+    uint64_t cipher_len;            // Ciphertext length announced by the size header
+    unsigned char size_header[sizeof(uint32_t)];
+    uint64_t kept_offset;           // Ciphertext offset of ciphertext[0]
+    size_t kept_len;
+    unsigned char ciphertext[ENCRYPT_KEEP_BYTES + ENCRYPT_PIECE_BYTES + 2 * EVP_MAX_BLOCK_LENGTH];
+    unsigned char piece[ENCRYPT_PIECE_BYTES];
+    FILE *spill;                    // Whole ciphertext (spill_ciphertext), or NULL when encrypting on demand
+} EncryptSource;
+
+/**
+ * @brief Ciphertext length for plaintext_len bytes: block modes (ECB, CBC) always add
+ * PKCS#7 padding, up to a whole block; CFB8 and OFB (block size 1) keep the length.
+ */
+static uint64_t ciphertext_length(const EVP_CIPHER *cipher, uint64_t plaintext_len) {
+    uint64_t block = (uint64_t)EVP_CIPHER_block_size(cipher);
+    return block > 1 ? (plaintext_len / block + 1) * block : plaintext_len;
+}
+
+/**
+ * @brief (Re)starts the cipher at the first plaintext byte.
+ * @return 0 on success, -1 on error.
+ */
+static int restart_encryption(EncryptSource *source) {
+    const unsigned char *key = source->key_iv;
+    const unsigned char *iv = source->key_iv + EVP_CIPHER_key_length(source->cipher);
+
+    cipher_stream_free(source->cipher_ctx);
+    source->cipher_ctx = cipher_stream_begin(source->cipher, key, iv, 1);
+    source->plain_offset = 0;
+    source->finished = 0;
+    source->kept_offset = 0;
+    source->kept_len = 0;
+    return source->cipher_ctx ? 0 : -1;
+}
+
+/**
+ * @brief Encrypts the next piece of plaintext (flushing the cipher after the last one),
+ * dropping all but the last ENCRYPT_KEEP_BYTES of the previous ciphertext.
+ * @return 0 on success, -1 on error or when the ciphertext is already complete.
+ */
+static int encrypt_next_piece(EncryptSource *source) {
+    if (source->finished) {
+        return -1;
+    }
+    if (source->kept_len > ENCRYPT_KEEP_BYTES) {
+        size_t dropped = source->kept_len - ENCRYPT_KEEP_BYTES;
+        memmove(source->ciphertext, source->ciphertext + dropped, ENCRYPT_KEEP_BYTES);
+        source->kept_offset += dropped;
+        source->kept_len = ENCRYPT_KEEP_BYTES;
+    }
+
+    uint64_t left = source->plain->len - source->plain_offset;
+    size_t n = left < ENCRYPT_PIECE_BYTES ? (size_t)left : ENCRYPT_PIECE_BYTES;
+    if (n > 0) {
+        if (read_payload(source->plain, source->plain_offset, source->piece, n) != TRUE) {
+            return -1;
+        }
+        int produced = cipher_stream_update(source->cipher_ctx, source->piece, (int)n, source->ciphertext + source->kept_len);
+        if (produced < 0) {
+            return -1;
+        }
+        source->plain_offset += n;
+        source->kept_len += (size_t)produced;
+    }
+
+    if (source->plain_offset == source->plain->len) {
+        int produced = cipher_stream_final(source->cipher_ctx, source->ciphertext + source->kept_len);
+        if (produced < 0) {
+            return -1;
+        }
+        source->kept_len += (size_t)produced;
+        source->finished = 1;
+        if (source->kept_offset + source->kept_len != source->cipher_len) {
+            fprintf(stderr, "Error: Ciphertext length does not match the size header.\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief read_at of encrypted payloads: the size header from memory, the ciphertext from
+ * the kept piece, encrypting forward (or restarting) until it holds the requested bytes.
+ */
+static int encrypt_source_read_at(PayloadSource *payload, uint64_t offset, unsigned char *out, size_t len) {
+    EncryptSource *source = (EncryptSource *)payload->state;
+
+    while (len > 0) {
+        size_t n;
+        if (offset < sizeof(uint32_t)) {
+            n = sizeof(uint32_t) - (size_t)offset < len ? sizeof(uint32_t) - (size_t)offset : len;
+            memcpy(out, source->size_header + offset, n);
+        } else {
+            uint64_t cipher_offset = offset - sizeof(uint32_t);
+            if (cipher_offset < source->kept_offset) {
+                if (restart_encryption(source) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if (cipher_offset >= source->kept_offset + source->kept_len) {
+                if (encrypt_next_piece(source) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+            size_t available = (size_t)(source->kept_offset + source->kept_len - cipher_offset);
+            n = available < len ? available : len;
+            memcpy(out, source->ciphertext + (cipher_offset - source->kept_offset), n);
+        }
+        out += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Encrypts the whole payload once into an anonymous temporary file, so that it can be
+ * read at any offset and from several threads (see spilled_source_read_at).
+ * @return 0 on success, -1 on error (printed).
+ */
+static int spill_ciphertext(EncryptSource *source) {
+    source->spill = tmpfile();
+    if (!source->spill) {
+        perror("Error: Cannot create a temporary file for the ciphertext");
+        return -1;
+    }
+    while (!source->finished) {
+        uint64_t written = source->kept_offset + source->kept_len;
+        if (encrypt_next_piece(source) != 0) {
+            return -1;
+        }
+        size_t n = (size_t)(source->kept_offset + source->kept_len - written);
+        if (fwrite(source->ciphertext + (written - source->kept_offset), 1, n, source->spill) != n) {
+            perror("Error: Cannot write the ciphertext to a temporary file");
+            return -1;
+        }
+    }
+    if (fflush(source->spill) != 0) {
+        perror("Error: Cannot write the ciphertext to a temporary file");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief read_at of spilled encrypted payloads: the size header from memory, the ciphertext
+ * from the temporary file with pread (no shared file offset, so workers can read concurrently).
+ */
+static int spilled_source_read_at(PayloadSource *payload, uint64_t offset, unsigned char *out, size_t len) {
+    EncryptSource *source = (EncryptSource *)payload->state;
+
+    while (len > 0) {
+        size_t n;
+        if (offset < sizeof(uint32_t)) {
+            n = sizeof(uint32_t) - (size_t)offset < len ? sizeof(uint32_t) - (size_t)offset : len;
+            memcpy(out, source->size_header + offset, n);
+        } else {
+            ssize_t got = pread(fileno(source->spill), out, len, (off_t)(offset - sizeof(uint32_t)));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return -1;
+            }
+            n = (size_t)got;
+        }
+        out += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void encrypt_source_close(PayloadSource *payload) {
+    EncryptSource *source = (EncryptSource *)payload->state;
+    cipher_stream_free(source->cipher_ctx);
+    if (source->spill) {
+        fclose(source->spill);
+    }
+    free(source);
+}
+
+/**
+ * @brief Derives the key and IV from -a/-m/-pass and wraps plain as an encrypted payload.
+ * plain must outlive payload (release payload first).
+ * @param spill Encrypt everything up front into a temporary file (embeds that read the
+ * payload out of order); otherwise encrypt on demand and walk the rows on one thread.
+ * @return SUCCESS or NO_SUCCESS.
+ */
+static int open_encrypt_source(const ProgramArgs *args, PayloadSource *plain, PayloadSource *payload, int spill) {
+    fprintf(status_stream(args), "Encrypting data...\n");
+
+    // get cypher function from openssl library
+    const EVP_CIPHER *cipher = get_evp_cipher(args->encryption_algo, args->mode);
+    if (!cipher) {
+        return NO_SUCCESS;
+    }
+
+    // The size header holds the ciphertext length: it has to fit in 4 bytes
+    uint64_t cipher_len = ciphertext_length(cipher, plain->len);
+    if (cipher_len > UINT32_MAX || cipher_len > SIZE_MAX - sizeof(uint32_t)) {
+        fprintf(stderr, "Error: Secret is too large to be encrypted (%zu bytes).\n", plain->len);
+        return NO_SUCCESS;
+    }
+
+    EncryptSource *source = calloc(1, sizeof(*source));
+    if (!source) {
+        fprintf(stderr, "Error: Failed to allocate memory for encryption.\n");
+        return NO_SUCCESS;
+    }
+    source->plain = plain;
+    source->cipher = cipher;
+    source->cipher_len = cipher_len;
+
+    // derive key and iv from password and retrieved cipher
+    if (derive_key_iv_pbkdf2(args->password, cipher, source->key_iv) != 0 || restart_encryption(source) != 0) {
+        cipher_stream_free(source->cipher_ctx);
+        free(source);
+        return NO_SUCCESS;
+    }
+    write_size_header(source->size_header, (long)cipher_len); // size in big-endian !
+
+    memset(payload, 0, sizeof(*payload));
+    payload->len = sizeof(uint32_t) + (size_t)cipher_len;
+    payload->read_at = encrypt_source_read_at;
+    payload->close = encrypt_source_close;
+    payload->state = source;
+    payload->sequential = 1;
+    if (spill) {
+        if (spill_ciphertext(source) != 0) {
+            close_payload_source(payload);
+            return NO_SUCCESS;
+        }
+        payload->read_at = spilled_source_read_at;
+        payload->sequential = 0;
+    }
+    return SUCCESS;
+}
 
 int handle_embed_mode(const ProgramArgs *args) {
     BMPImage *image = NULL;
-    unsigned char *secret_buffer = NULL; // (real size || data || ext)
+    PayloadSource secret = {0};     // (real size || data || ext), read from the secret file
+    PayloadSource encrypted = {0};  // (encrypted size || encrypted data), encrypted on the fly
+    PayloadSource *payload = &secret;
     int result = NO_SUCCESS;
 
-    size_t buffer_len_bytes = 0;
-    size_t required_bits = 0;
-    int bits_per_pixel = 0;
-
     image = open_bmp(args->bitmap_file);
     if (!image) {
         goto cleanup;
     }
 
-    // Build non-encrypted secret buffer
-    secret_buffer = build_secret_buffer(args->input_file, &buffer_len_bytes);
-    if (!secret_buffer) {
+    const StegoAlgorithm *algorithm = find_stego_algorithm(args->steg_algorithm);
+    if (!algorithm) {
+        fprintf(stderr, ERR_INVALID_STEG_ALGORITHM, args->steg_algorithm);
         goto cleanup;
     }
 
-
-    // encryption logic
-    if (prepare_encryption(args, &secret_buffer, &buffer_len_bytes) != SUCCESS) {
+    // The secret is streamed: read window by window as the pixels are embedded
+    if (open_secret_source(args->input_file, &secret) != TRUE) {
         goto cleanup;
     }
+    if (args->password) {
+        // LSBI reads the payload twice (inversion map, then embed) and -threads splits it
+        // across workers: both need random access to the ciphertext
+        int spill = algorithm->control_bits > 0 || args->threads > 1;
+        if (open_encrypt_source(args, &secret, &encrypted, spill) != SUCCESS) {
+            goto cleanup;
+        }
+        payload = &encrypted;
+    }
 
-
-    if (strcmp(args->steg_algorithm, "LSB1") == 0) {
-        bits_per_pixel = LSB1_BITS_PER_PIXEL;
-        required_bits = buffer_len_bytes * 8;
-    } else if (strcmp(args->steg_algorithm, "LSB4") == 0) {
-        bits_per_pixel = LSB4_BITS_PER_PIXEL;
-        required_bits = buffer_len_bytes * 8;
-    } else if (strcmp(args->steg_algorithm, "LSBI") == 0) {
-        bits_per_pixel = LSBI_BITS_PER_PIXEL;
-        required_bits = (buffer_len_bytes * 8) + LSBI_CONTROL_BITS;
-    } else {
-        fprintf(stderr, ERR_INVALID_STEG_ALGORITHM, args->steg_algorithm);
+    if (check_stego_capacity(algorithm, image, payload->len) != TRUE) {
         goto cleanup;
     }
 
-    if (check_bmp_capacity(image, required_bits, bits_per_pixel) != TRUE) {
-        goto cleanup;
+    if (args->io_engine && strcmp(args->io_engine, "uring") == 0) {
+        image->io_engine = BMP_IO_URING;
+    } else if (args->io_engine && strcmp(args->io_engine, "threads") == 0) {
+        image->io_engine = BMP_IO_THREADS;
+    }
+    if (args->threads > 0) {
+        image->threads = (unsigned int)args->threads;
     }
 
-    FILE *out_fp = fopen(args->output_file, "wb");
-    if (!out_fp) {
-        perror(args->output_file);
+    if (!open_output_bmp(image, args->output_file, args->clone_output)) {
         goto cleanup;
     }
-    image->out = out_fp;
 
-    if (strcmp(args->steg_algorithm, "LSB1") == 0) {
-        if (embed_lsb1(image, secret_buffer, buffer_len_bytes) == 0) {
-            result = SUCCESS;
-        }
-    } else if(strcmp(args->steg_algorithm, "LSB4") == 0) {
-        if (embed_lsb4(image, secret_buffer, buffer_len_bytes) == 0) {
-            result = SUCCESS;
-        }
-    } else if (strcmp(args->steg_algorithm, "LSBI") == 0) {
-        if (embed_lsbi(image, secret_buffer, buffer_len_bytes) == 0) {
-            result = SUCCESS;
-        }
+    if (algorithm->embed(algorithm, image, payload) == 0) {
+        result = SUCCESS;
+    }
+
+    if (result == SUCCESS && !close_bmp(image)) {
+        result = NO_SUCCESS;
     }
 
 
     cleanup:
-    free_secret_buffer(secret_buffer);
+    close_payload_source(&encrypted);
+    close_payload_source(&secret);
 
     if (image) {
         free_bmp_image(image);
@@ -90,172 +356,465 @@ int handle_embed_mode(const ProgramArgs *args) {
 }
 
 
-int prepare_encryption(const ProgramArgs *args, unsigned char **secret_buffer_ptr, size_t *buffer_len_bytes_ptr) {
-    if (!args->password) {
-        return SUCCESS; // No encryption needed
+/**
+ * @brief Key material used to check encrypted payload headers during -steg auto.
+ */
+typedef struct {
+    const EVP_CIPHER *cipher;
+    const unsigned char *key;
+    const unsigned char *iv;
+} CipherCheckContext;
+
+/**
+ * @brief Derives the key and IV from -a/-m/-pass into key_iv and points check at them.
+ * @return SUCCESS or NO_SUCCESS.
+ */
+static int prepare_cipher_check(const ProgramArgs *args, CipherCheckContext *check, unsigned char key_iv[KEY_IV_LEN]) {
+    check->cipher = get_evp_cipher(args->encryption_algo, args->mode);
+    if (!check->cipher || derive_key_iv_pbkdf2(args->password, check->cipher, key_iv) != 0) {
+        return NO_SUCCESS;
     }
+    check->key = key_iv;
+    check->iv = key_iv + EVP_CIPHER_key_length(check->cipher);
+    return SUCCESS;
+}
 
-    printf("Encrypting data...\n");
+/**
+ * @brief Decrypts the first ciphertext blocks kept by peek_payload and reads the inner size
+ * header (size || data || .ext\0).
+ * @return SUCCESS, or NO_SUCCESS if not even the 4 header bytes could be decrypted.
+ */
+static int decrypt_inner_size(const StegoPayloadInfo *info, const CipherCheckContext *check, uint32_t *inner_size) {
+    unsigned char plaintext[PAYLOAD_HEAD_LEN];
+
+    int len = decrypt_prefix(info->head, (int)info->head_len, check->cipher, check->key, check->iv, plaintext);
+    if (len < (int)sizeof(uint32_t)) {
+        return NO_SUCCESS;
+    }
+    *inner_size = read_size_header(plaintext);
+    return SUCCESS;
+}
 
-    unsigned char *encrypted_data = NULL;
-    unsigned char *final_buffer = NULL;
-    int result = NO_SUCCESS;
+/**
+ * @brief Reads the extension of an encrypted payload: it ends the plaintext (size || data ||
+ * .ext\0, then the PKCS#7 padding in ECB and CBC), so only the last ciphertext blocks are
+ * read from the carrier and decrypted (see decrypt_at).
+ * @param inner_size Inner size header (decrypt_inner_size): the extension starts after the data.
+ * @param extension Set to the '\0'-terminated extension.
+ * @return SUCCESS, or NO_SUCCESS if the tail does not decrypt to an extension (e.g. wrong password).
+ */
+static int decrypt_extension(const StegoAlgorithm *algorithm, BMPImage *image, const StegoPayloadInfo *info,
+                             const CipherCheckContext *check, uint32_t inner_size, char extension[MAX_EXT_LEN]) {
+    unsigned char ciphertext[MAX_EXT_LEN + 4 * EVP_MAX_BLOCK_LENGTH];
+    unsigned char plaintext[sizeof(ciphertext) + EVP_MAX_BLOCK_LENGTH];
+    const uint64_t block = (uint64_t)EVP_CIPHER_block_size(check->cipher);
+    const uint64_t iv_len = (uint64_t)EVP_CIPHER_iv_length(check->cipher);
+    const uint64_t ext_start = sizeof(uint32_t) + (uint64_t)inner_size;    // In the plaintext
+
+    if (ext_start >= info->data_size) {
+        return NO_SUCCESS;
+    }
 
-    // get cypher function from openssl library
+    // Decrypt from the cipher block holding the extension; CBC and CFB also need the
+    // ciphertext before it (or start at the IV)
+    uint64_t start = ext_start - ext_start % block;
+    int chained = EVP_CIPHER_mode(check->cipher) == EVP_CIPH_CBC_MODE || EVP_CIPHER_mode(check->cipher) == EVP_CIPH_CFB_MODE;
+    if (chained && start < iv_len) {
+        start = 0;
+    }
+    uint64_t first = chained && start > 0 ? start - iv_len : start;
+    if (info->data_size - first > sizeof(ciphertext)) {
+        return NO_SUCCESS;
+    }
+    size_t read_len = (size_t)(info->data_size - first);
+    if (read_payload_data(algorithm, image, first, ciphertext, read_len) != EXIT_SUCCESS) {
+        return NO_SUCCESS;
+    }
+    size_t before = (size_t)(start - first);
+    int len = decrypt_at(ciphertext + before, (int)(read_len - before), start, ciphertext,
+                         check->cipher, check->key, check->iv, plaintext);
+    if (len != (int)(read_len - before)) {
+        return NO_SUCCESS;
+    }
+
+    // Strip the padding (a full block at most), then expect ".ext\0" up to the end
+    size_t plain_end = (size_t)len;
+    if (block > 1) {
+        size_t padding = plaintext[len - 1];
+        if (padding == 0 || padding > block || padding > plain_end) {
+            return NO_SUCCESS;
+        }
+        plain_end -= padding;
+    }
+    size_t ext_offset = (size_t)(ext_start - start);
+    if (ext_offset + 2 > plain_end || plain_end - ext_offset > MAX_EXT_LEN) {
+        return NO_SUCCESS;
+    }
+    const unsigned char *ext = plaintext + ext_offset;
+    size_t ext_len = plain_end - ext_offset;
+    if (ext[0] != '.' || memchr(ext, '\0', ext_len) != ext + ext_len - 1) {
+        return NO_SUCCESS;
+    }
+    memcpy(extension, ext, ext_len);
+    return SUCCESS;
+}
+
+/**
+ * @brief -steg auto on encrypted payloads: the inner size header of a candidate must fit in
+ * its ciphertext.
+ */
+static int encrypted_header_plausible(const StegoPayloadInfo *info, void *ctx) {
+    uint32_t inner_size = 0;
+
+    if (decrypt_inner_size(info, (const CipherCheckContext *)ctx, &inner_size) != SUCCESS) {
+        return 0;
+    }
+    return (uint64_t)inner_size + sizeof(uint32_t) + 2 <= info->data_size;   // Shortest extension: ".\0"
+}
+
+/**
+ * @brief Resolves -steg for extract/info: a registry entry, or (auto / not given) the one whose
+ * header probe matches. Encrypted candidates are checked by decrypting their first blocks.
+ * @return The algorithm, or NULL (the error is printed).
+ */
+static const StegoAlgorithm *resolve_algorithm(const ProgramArgs *args, BMPImage *image, char encrypted, int announce) {
+    if (args->steg_algorithm && strcmp(args->steg_algorithm, STEG_AUTO) != 0) {
+        const StegoAlgorithm *algorithm = find_stego_algorithm(args->steg_algorithm);
+        if (!algorithm) {
+            fprintf(stderr, "Error: Steganography algorithm '%s' not supported for extraction.\n", args->steg_algorithm);
+        }
+        return algorithm;
+    }
+
+    // Probe each algorithm's header on the first pixels, extract only with the match
+    CipherCheckContext cipher_check = {0};
+    unsigned char check_key_iv[KEY_IV_LEN];
+    if (encrypted && prepare_cipher_check(args, &cipher_check, check_key_iv) != SUCCESS) {
+        return NULL;
+    }
+    const StegoAlgorithm *algorithm = detect_stego_algorithm(image, encrypted, encrypted ? encrypted_header_plausible : NULL, &cipher_check);
+    if (!algorithm) {
+        fprintf(stderr, "Error: Could not detect the steganography algorithm used in '%s'.\n", args->bitmap_file);
+        if (image->in_streamed && !encrypted) {
+            fprintf(stderr, "On a piped carrier -steg auto only recognizes files of up to %d KB: pass -steg.\n",
+                    STREAM_PROBE_BYTES / 1024);
+        }
+    } else if (announce) {
+        fprintf(status_stream(args), "Detected steganography algorithm: %s\n", algorithm->name);
+    }
+    return algorithm;
+}
+
+#define DECRYPT_PIECE_BYTES (64 * 1024) // Ciphertext bytes decrypted per cipher update
+
+/**
+ * @brief Extraction sink of encrypted payloads: decrypts the ciphertext as it is decoded and
+ * splits the plaintext (real size || real data || ext) on the fly, writing the data to the
+ * output file and keeping the extension.
+ */
+typedef struct {
+    EVP_CIPHER_CTX *cipher_ctx;
+    SecretFileSink *out;
+    unsigned char size_header[sizeof(uint32_t)];
+    size_t size_header_len;
+    uint32_t data_size;             // Inner size header: bytes of the hidden file
+    uint64_t data_written;
+    char extension[MAX_EXT_LEN];    // Everything after the data (".ext\0")
+    size_t extension_len;
+    unsigned char plaintext[DECRYPT_PIECE_BYTES + EVP_MAX_BLOCK_LENGTH];
+} DecryptSink;
+
+/**
+ * @brief Routes decrypted bytes to the size header, the output file or the extension.
+ * @return 0 on success, -1 on error (printed).
+ */
+static int consume_plaintext(DecryptSink *sink, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        size_t n;
+        if (sink->size_header_len < sizeof(uint32_t)) {
+            n = sizeof(uint32_t) - sink->size_header_len;
+            n = n < len ? n : len;
+            memcpy(sink->size_header + sink->size_header_len, data, n);
+            sink->size_header_len += n;
+            if (sink->size_header_len == sizeof(uint32_t)) {
+                sink->data_size = read_size_header(sink->size_header);  // big-endian
+            }
+        } else if (sink->data_written < sink->data_size) {
+            n = sink->data_size - sink->data_written < len ? (size_t)(sink->data_size - sink->data_written) : len;
+            if (write_secret_chunk(sink->out, data, n) != 0) {
+                return -1;
+            }
+            sink->data_written += n;
+        } else {
+            n = len;
+            if (n > MAX_EXT_LEN - sink->extension_len) {
+                fprintf(stderr, "Error: Extension in decrypted data exceeds the maximum allowed size (%d bytes).\n", MAX_EXT_LEN);
+                return -1;
+            }
+            memcpy(sink->extension + sink->extension_len, data, n);
+            sink->extension_len += n;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief payload_sink_func_t of encrypted extractions: decrypts a chunk of ciphertext.
+ */
+static int decrypt_sink_write(void *ctx, const unsigned char *data, size_t len) {
+    DecryptSink *sink = (DecryptSink *)ctx;
+
+    while (len > 0) {
+        size_t n = len < DECRYPT_PIECE_BYTES ? len : DECRYPT_PIECE_BYTES;
+        int produced = cipher_stream_update(sink->cipher_ctx, data, (int)n, sink->plaintext);
+        if (produced < 0 || consume_plaintext(sink, sink->plaintext, (size_t)produced) != 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Derives the key and IV from -a/-m/-pass and starts decrypting into out.
+ * @return The sink (free with free_decrypt_sink), or NULL on error.
+ */
+static DecryptSink *open_decrypt_sink(const ProgramArgs *args, SecretFileSink *out) {
     const EVP_CIPHER *cipher = get_evp_cipher(args->encryption_algo, args->mode);
     if (!cipher) {
-        goto cleanup_enc;
+        return NULL;
     }
 
     // derive key and iv from password and retrieved cipher
     unsigned char key_iv_buffer[KEY_IV_LEN];
     if (derive_key_iv_pbkdf2(args->password, cipher, key_iv_buffer) != 0) {
-        goto cleanup_enc;
+        return NULL;
     }
     const unsigned char *key = key_iv_buffer;
     const unsigned char *iv = key_iv_buffer + EVP_CIPHER_key_length(cipher);
 
-    // encrypt
-    int encrypted_len = 0;
-    encrypted_data = encrypt_data(*secret_buffer_ptr, *buffer_len_bytes_ptr, cipher, key, iv, &encrypted_len);
-    if (!encrypted_data) {
-        fprintf(stderr, "Error: Encryption failed.\n");
-        goto cleanup_enc;
+    DecryptSink *sink = calloc(1, sizeof(*sink));
+    if (!sink) {
+        fprintf(stderr, "Error: Failed to allocate memory for decryption.\n");
+        return NULL;
     }
-
-    // final buffer: (encrypted size || encrypted data)
-    size_t final_buffer_len = sizeof(uint32_t) + encrypted_len;
-    final_buffer = malloc(final_buffer_len);
-    if (!final_buffer) {
-        fprintf(stderr, "Error: Failed to allocate memory for final encrypted buffer.\n");
-        goto cleanup_enc;
+    sink->cipher_ctx = cipher_stream_begin(cipher, key, iv, 0);
+    if (!sink->cipher_ctx) {
+        free(sink);
+        return NULL;
     }
+    sink->out = out;
+    return sink;
+}
 
-    write_size_header(final_buffer, (long)encrypted_len); // size in big-endian !
-    memcpy(final_buffer + sizeof(uint32_t), encrypted_data, encrypted_len);
-
-    free_secret_buffer(*secret_buffer_ptr); // free original buffer
-    *secret_buffer_ptr = final_buffer;      // point to final buffer w/ encrypted data ;)
-    *buffer_len_bytes_ptr = final_buffer_len;
-
-    final_buffer = NULL;
-    result = SUCCESS;
+/**
+ * @brief Flushes the cipher (checks the padding) and validates the decrypted structure:
+ * a whole size header, all the data it announces and a '\0'-terminated extension.
+ * @return SUCCESS or NO_SUCCESS.
+ */
+static int finish_decrypt_sink(DecryptSink *sink) {
+    int produced = cipher_stream_final(sink->cipher_ctx, sink->plaintext);
+    if (produced < 0 || consume_plaintext(sink, sink->plaintext, (size_t)produced) != 0) {
+        return NO_SUCCESS;
+    }
 
-cleanup_enc:
-    if (encrypted_data) {
-        free(encrypted_data);
+    if (sink->size_header_len < sizeof(uint32_t)) {
+        fprintf(stderr, "Error: Decrypted data too short to contain size header.\n");
+        return NO_SUCCESS;
     }
-    return result;
+    // at least 1 byte for extension (null terminator)
+    if (sink->data_written < sink->data_size || sink->extension_len < 1) {
+        fprintf(stderr, "Error: Decrypted data too short. Expected at least %zu bytes.\n",
+                sizeof(uint32_t) + (size_t)sink->data_size + 1);
+        return NO_SUCCESS;
+    }
+    // last byte should be '\0'
+    if (sink->extension[sink->extension_len - 1] != '\0') {
+        fprintf(stderr, "Error: Extension in decrypted data is not properly null-terminated.\n");
+        return NO_SUCCESS;
+    }
+    return SUCCESS;
 }
 
+static void free_decrypt_sink(DecryptSink *sink) {
+    if (sink) {
+        cipher_stream_free(sink->cipher_ctx);
+        free(sink);
+    }
+}
 
 int handle_extract_mode(const ProgramArgs *args) {
     BMPImage *image = NULL;
-    unsigned char *extracted_buffer = NULL; // Buffer: (encrypted data) or (real data || ext)
-    unsigned char *decrypted_buffer = NULL; // Buffer: (size || real data || ext)
+    SecretFileSink out = {0};       // Temporary output file, renamed once the extension is known
+    DecryptSink *decrypt = NULL;    // Encrypted payloads: (size || real data || ext) is decrypted on the fly
+    StegoPayloadInfo info;
     int result = NO_SUCCESS;
     char encrypted = FALSE;
     if (args->password) {
         encrypted = TRUE;
     }
-    size_t extracted_len;
-    size_t extension_len;
 
+    // A streamed carrier (-p -) is read as far as the decoder gets: rows after the payload never are
     image = open_bmp(args->bitmap_file);
     if (!image) {
         goto cleanup_ext;
     }
+    if (args->threads > 0) {
+        image->threads = (unsigned int)args->threads;
+    }
 
-    if (strcmp(args->steg_algorithm, "LSB1") == 0) {
-        extracted_buffer = lsb1_extract(image, &extracted_len,&extension_len, encrypted);
-    } else if (strcmp(args->steg_algorithm, "LSB4") == 0) {
-        extracted_buffer = lsb4_extract(image, &extracted_len,&extension_len, encrypted);
-    } else if (strcmp(args->steg_algorithm, "LSBI") == 0) {
-        extracted_buffer = lsbi_extract(image, &extracted_len,&extension_len, encrypted);
-    } else {
-        fprintf(stderr, "Error: Steganography algorithm '%s' not supported for extraction.\n", args->steg_algorithm);
+    const StegoAlgorithm *algorithm = resolve_algorithm(args, image, encrypted, TRUE);
+    if (!algorithm) {
         goto cleanup_ext;
     }
 
-    if (!extracted_buffer) {
-        fprintf(stderr, "Error: Failed to extract data from BMP image.\n");
+    // Decoded chunks are written out as they are produced: memory stays bounded whatever the payload size
+    if (open_secret_sink(args->output_file, &out) != 0) {
         goto cleanup_ext;
     }
+    payload_sink_func_t sink = write_secret_chunk;
+    void *sink_ctx = &out;
+    if (encrypted) {
+        fprintf(status_stream(args), "Decrypting data...\n");
+        decrypt = open_decrypt_sink(args, &out);
+        if (!decrypt) {
+            goto cleanup_ext;
+        }
+        sink = decrypt_sink_write;
+        sink_ctx = decrypt;
+    }
 
-    // decryption logic
-    if (args->password) {
-        printf("Decrypting data...\n");
+    int extracted;
+    if (args->range_offset >= 0 || args->range_length >= 0) {
+        // -offset / -length: decode only that slice of the hidden file
+        uint64_t offset = args->range_offset >= 0 ? (uint64_t)args->range_offset : 0;
+        uint64_t length = args->range_length >= 0 ? (uint64_t)args->range_length : 0;
+        extracted = extract_payload_range(algorithm, image, offset, length, sink, sink_ctx, &info);
+    } else {
+        extracted = algorithm->extract(algorithm, image, encrypted, sink, sink_ctx, &info);
+    }
 
-        const EVP_CIPHER *cipher = get_evp_cipher(args->encryption_algo, args->mode);
-        if (!cipher) goto cleanup_ext;
+    if (extracted != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Failed to extract data from BMP image.\n");
+        goto cleanup_ext;
+    }
 
-        // derive key and iv from password and retrieved cipher
-        unsigned char key_iv_buffer[KEY_IV_LEN];
-        if (derive_key_iv_pbkdf2(args->password, cipher, key_iv_buffer) != 0) {
-            goto cleanup_ext;
-        }
-        const unsigned char *key = key_iv_buffer;
-        const unsigned char *iv = key_iv_buffer + EVP_CIPHER_key_length(cipher);
-
-        // decrypt
-        int decrypted_len = 0;
-        decrypted_buffer = decrypt_data(extracted_buffer, extracted_len, cipher, key, iv, &decrypted_len);
-        if (!decrypted_buffer) {
-            // El error ya se imprimió en decrypt_data
+    // The extension comes last: after the data (plain) or at the end of the plaintext (encrypted)
+    const char *extension = info.extension;
+    if (decrypt) {
+        if (finish_decrypt_sink(decrypt) != SUCCESS) {
             goto cleanup_ext;
         }
+        extension = decrypt->extension;
+    }
+    if (finish_secret_sink(&out, args->output_file, extension) == 0) {
+        result = SUCCESS;
+    }
 
-        // Parse decrypted buffer: (real_size || real_data || ext)
-        // The decrypted buffer contains the original structure from build_secret_buffer
-        if (decrypted_len < (int) sizeof(uint32_t)) {
-            fprintf(stderr, "Error: Decrypted data too short to contain size header.\n");
-            goto cleanup_ext;
-        }
+cleanup_ext:
+    discard_secret_sink(&out);
+    free_decrypt_sink(decrypt);
+    if (image) {
+        free_bmp_image(image);
+    }
+    return result;
+}
 
-        // real size from first 4 bytes (big-endian)
-        uint32_t real_data_size = read_size_header(decrypted_buffer);
-        
-        // expected total size: size_header + data + extension
-        size_t min_expected_size = sizeof(uint32_t) + real_data_size + 1; // at least 1 byte for extension (null terminator)
-        if (decrypted_len < (int) min_expected_size) {
-            fprintf(stderr, "Error: Decrypted data too short. Expected at least %zu bytes, got %d.\n", min_expected_size, decrypted_len);
-            goto cleanup_ext;
+/**
+ * @brief Prints a JSON string literal, escaping quotes, backslashes and control bytes.
+ */
+static void print_json_string(const char *str) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
         }
+    }
+    putchar('"');
+}
 
-        unsigned char *real_data_ptr = decrypted_buffer + sizeof(uint32_t);
-        const unsigned char *ext_ptr = real_data_ptr + real_data_size;
-        size_t ext_len = decrypted_len - sizeof(uint32_t) - real_data_size;
+int handle_info_mode(const ProgramArgs *args) {
+    BMPImage *image = NULL;
+    StegoPayloadInfo info;
+    int result = NO_SUCCESS;
+    char encrypted = args->password ? TRUE : FALSE;
+    uint32_t inner_size = 0;
+    int have_inner_size = FALSE;
+    int have_extension = !encrypted;
 
-        // verify null terminator for extension
-        if (ext_len < 1) {
-            fprintf(stderr, "Error: Decrypted data missing extension terminator.\n");
-            goto cleanup_ext;
-        }
+    image = open_bmp(args->bitmap_file);
+    if (!image) {
+        goto cleanup_info;
+    }
 
-        // last byte should be '\0'
-        if (ext_ptr[ext_len - 1] != '\0') {
-            fprintf(stderr, "Error: Extension in decrypted data is not properly null-terminated.\n");
-            goto cleanup_ext;
-        }
+    // Only the size header and the extension are decoded (a mapped carrier only reads their
+    // pages, a streamed one drops the rows it jumps over)
+    const StegoAlgorithm *algorithm = resolve_algorithm(args, image, encrypted, FALSE);
+    if (!algorithm) {
+        goto cleanup_info;
+    }
+    if (peek_payload(algorithm, image, encrypted, &info) != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: No valid %s payload header found in '%s'.\n", algorithm->name, args->bitmap_file);
+        goto cleanup_info;
+    }
 
-        // Write the file using the parsed data
-        if (write_secret_from_buffer(args->output_file, real_data_ptr, real_data_size, ext_len) == 0) {
-            result = SUCCESS;
+    // Encrypted: the file size is the inner header, in the first decrypted block, and the
+    // extension is in the last ones
+    if (encrypted) {
+        CipherCheckContext cipher_check;
+        unsigned char key_iv[KEY_IV_LEN];
+        if (prepare_cipher_check(args, &cipher_check, key_iv) != SUCCESS) {
+            goto cleanup_info;
         }
+        have_inner_size = decrypt_inner_size(&info, &cipher_check, &inner_size) == SUCCESS;
+        have_extension = have_inner_size &&
+                         decrypt_extension(algorithm, image, &info, &cipher_check, inner_size, info.extension) == SUCCESS;
+    }
 
+    if (args->json_output) {
+        printf("{\"algorithm\": ");
+        print_json_string(algorithm->name);
+        printf(", \"encrypted\": %s", encrypted ? "true" : "false");
+        if (encrypted) {
+            printf(", \"encrypted_size\": %u", info.data_size);
+        }
+        if (!encrypted || have_inner_size) {
+            printf(", \"size\": %u", encrypted ? inner_size : info.data_size);
+        } else {
+            printf(", \"size\": null");
+        }
+        printf(", \"extension\": ");
+        if (have_extension) {
+            print_json_string(info.extension);
+        } else {
+            printf("null");
+        }
+        printf("}\n");
     } else {
-        // No encryption, write directly
-
-        if (write_secret_from_buffer(args->output_file, extracted_buffer, extracted_len,extension_len) == 0) {
-            result = SUCCESS;
+        printf("Algorithm: %s\n", algorithm->name);
+        if (encrypted) {
+            printf("Encrypted size: %u bytes\n", info.data_size);
+            if (have_inner_size) {
+                printf("Size: %u bytes\n", inner_size);
+            }
+            printf("Extension: %s\n", have_extension ? info.extension : "(unknown)");
+        } else {
+            printf("Size: %u bytes\n", info.data_size);
+            printf("Extension: %s\n", info.extension);
         }
     }
+    result = SUCCESS;
 
-cleanup_ext:
-    if (extracted_buffer) free(extracted_buffer);
-    if (decrypted_buffer) free(decrypted_buffer);
+    cleanup_info:
     if (image) {
         free_bmp_image(image);
     }
     return result;
-}
\ No newline at end of file
+}
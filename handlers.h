@@ -3,6 +3,7 @@
 
 #include "parser.h" // For ProgramArgs
 #include <stddef.h> // For size_t
+#include <stdio.h>  // For FILE
 /**
  * @brief Handles the entire embedding process, from file preparation to execution.
  * * This function performs file I/O, resource management (BMPImage, secret_buffer),
@@ -14,10 +15,30 @@
 #define SUCCESS 1
 #define NO_SUCCESS 0
 
-int handle_embed_mode(const ProgramArgs *args);
+/**
+ * @brief Binds the steganography kernels (-kernel, or the best level the CPU supports).
+ * @param args Program arguments parsed from command line.
+ * @return SUCCESS, or NO_SUCCESS if the requested level is not supported.
+ */
+int select_kernels(const ProgramArgs *args);
+
+/**
+ * @brief Stream for progress messages: stdout, or stderr when stdout carries the output (-out -).
+ * @param args Program arguments parsed from command line.
+ */
+FILE *status_stream(const ProgramArgs *args);
 
-int prepare_encryption(const ProgramArgs *args, unsigned char **secret_buffer_ptr, size_t *buffer_len_bytes_ptr);
+int handle_embed_mode(const ProgramArgs *args);
 
 int handle_extract_mode(const ProgramArgs *args);
 
+/**
+ * @brief Prints the size and extension of the hidden payload (-info) without extracting it.
+ * Only the size header and the extension bytes are decoded; with -pass the file size is
+ * read from the first decrypted block and the extension is reported as encrypted.
+ * @param args Program arguments parsed from command line (-json selects JSON output).
+ * @return SUCCESS, or NO_SUCCESS if no valid payload header is found.
+ */
+int handle_info_mode(const ProgramArgs *args);
+
 #endif //HANDLERS_H
\ No newline at end of file
@@ -30,14 +30,24 @@ int main(int argc, char *argv[]) {
     // Debug arguments
     // debug_arguments(&args);
 
+    // Bind the steganography kernels once, before any worker starts
+    if (select_kernels(&args) != SUCCESS) {
+        return 1;
+    }
+
     if (args.embed_mode) {
         int result = handle_embed_mode(&args);
         if (result == SUCCESS) {
-            printf("Success generating steganography\n");
+            fprintf(status_stream(&args), "Success generating steganography\n");
         } else {
             fprintf(stderr, "Embedding failed.\n");
             exit_code = 1;
         }
+    } else if (args.info_mode) {
+        if (handle_info_mode(&args) != SUCCESS) {
+            fprintf(stderr, "Info failed.\n");
+            exit_code = 1;
+        }
     } else if (args.extract_mode) {
         int result = handle_extract_mode(&args);
         if (result != SUCCESS) {
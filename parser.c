@@ -2,8 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <errno.h>
 #include "error.h"
 #include "parser.h"
+#include "steganography/steganography.h"
 
 
 
@@ -14,33 +16,84 @@ void print_help(const char *program_name) {
         "Required parameters:\n"
         "  -embed                    Indicates that information will be hidden\n"
         "  -extract                  Indicates that information will be extracted\n"
+        "  -info                     Prints the size and extension of the hidden payload\n"
+        "                            (no -out needed; -steg defaults to auto)\n"
         "  -in file                  File to be hidden\n"
         "  -p bitmapfile             BMP file that will act as the carrier\n"
         "  -out bitmapfile           Output BMP file (with embedded data)\n"
-        "  -steg <LSB1|LSB4|LSBI>    Steganographic algorithm to use\n"
+        "                            '-' as -in/-p reads stdin, as -out writes stdout\n"
+        "  -steg <LSB1|LSB2|LSB3|LSB4|LSBI>\n"
+        "                            Steganographic algorithm to use\n"
         "                            LSB1: LSB of 1 bit\n"
+        "                            LSB2: LSB of 2 bits\n"
+        "                            LSB3: LSB of 3 bits\n"
         "                            LSB4: LSB of 4 bits\n"
-        "                            LSBI: LSB Enhanced (Improved)\n\n"
+        "                            LSBI: LSB Enhanced (Improved)\n"
+        "                            auto: (extract, info) detect it from the payload header\n\n"
         "Optional parameters:\n"
         "  -a <aes128|aes192|aes256|3des>  Encryption algorithm\n"
         "  -m <ecb|cfb|ofb|cbc>            Mode of operation\n"
         "  -pass password                   Encryption password\n"
+        "  -clone                           Embed: reflink the carrier (btrfs, XFS) and rewrite\n"
+        "                                   only the modified pages; falls back to a full copy\n"
+        "  -io <mmap|uring|threads>         Embed: output I/O engine (default mmap); uring and\n"
+        "                                   threads pipeline large read/write blocks\n"
+        "  -threads N                       Split embedding and the extraction of the data\n"
+        "                                   over N worker threads (same results)\n"
+        "  -json                            Info: print the metadata as a JSON object\n"
+        "  -offset X -length N              Extract: only bytes X .. X+N-1 of the hidden file\n"
+        "                                   (unencrypted payloads; either may be omitted)\n"
+        "  -kernel <auto|scalar|sse|avx2|avx512>\n"
+        "                                   Force a SIMD kernel level (default auto: the\n"
+        "                                   widest one the CPU supports)\n"
         "  -h, --help                       Show this help message\n\n"
         "Example:\n"
         "  %s -embed -in secret.txt -p image.bmp -out stego.bmp -steg LSB1\n"
-        "  %s -extract -p stego.bmp -out secret.txt -steg LSB1\n",
-        program_name, program_name, program_name
+        "  %s -extract -p stego.bmp -out secret.txt -steg LSB1\n"
+        "  %s -info -p stego.bmp -json\n",
+        program_name, program_name, program_name, program_name
     );
     
 }
 
+/**
+ * @brief Parses the -threads value.
+ * @return The thread count (1..MAX_THREADS), or -1 if it is not a valid count.
+ */
+static int parse_thread_count(const char *value) {
+    char *end = NULL;
+    long count = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || count < 1 || count > MAX_THREADS) {
+        return -1;
+    }
+    return (int)count;
+}
+
+/**
+ * @brief Parses a -offset / -length value.
+ * @return The value, or -2 if it is not a non-negative decimal number.
+ */
+static int64_t parse_byte_count(const char *value) {
+    char *end = NULL;
+    errno = 0;
+    long long count = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 || count < 0) {
+        return -2;
+    }
+    return (int64_t)count;
+}
+
 int parse_arguments(int argc, char *argv[], ProgramArgs *args) {
     // Initialize all fields to default values
     memset(args, 0, sizeof(ProgramArgs));
+    args->range_offset = -1;
+    args->range_length = -1;
 
     static struct option long_opts[] = {
         {"embed",    no_argument,       0, 'E'},
         {"extract",  no_argument,       0, 'X'},
+        {"info",     no_argument,       0, 'N'},
+        {"json",     no_argument,       0, 'J'},
         {"in",       required_argument, 0, 'i'},
         {"p",        required_argument, 0, 'p'},
         {"out",      required_argument, 0, 'o'},
@@ -48,6 +101,12 @@ int parse_arguments(int argc, char *argv[], ProgramArgs *args) {
         {"a",        required_argument, 0, 'a'},
         {"m",        required_argument, 0, 'm'},
         {"pass",     required_argument, 0, 'P'},
+        {"clone",    no_argument,       0, 'C'},
+        {"io",       required_argument, 0, 'I'},
+        {"kernel",   required_argument, 0, 'K'},
+        {"threads",  required_argument, 0, 'T'},
+        {"offset",   required_argument, 0, 'F'},
+        {"length",   required_argument, 0, 'L'},
         {"help",     no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
@@ -55,10 +114,12 @@ int parse_arguments(int argc, char *argv[], ProgramArgs *args) {
     int opt;
     int long_index = 0;
     
-    while ((opt = getopt_long_only(argc, argv, "W;EXi:p:o:s:a:m:P:h", long_opts, &long_index)) != -1) {
+    while ((opt = getopt_long_only(argc, argv, "W;EXNJi:p:o:s:a:m:P:CI:K:T:F:L:h", long_opts, &long_index)) != -1) {
         switch (opt) {
             case 'E': args->embed_mode = 1; break;
             case 'X': args->extract_mode = 1; break;
+            case 'N': args->info_mode = 1; break;
+            case 'J': args->json_output = 1; break;
             case 'i': args->input_file = optarg; break;
             case 'p': args->bitmap_file = optarg; break;
             case 'o': args->output_file = optarg; break;
@@ -66,6 +127,12 @@ int parse_arguments(int argc, char *argv[], ProgramArgs *args) {
             case 'a': args->encryption_algo = optarg; break;
             case 'm': args->mode = optarg; break;
             case 'P': args->password = optarg; break;
+            case 'C': args->clone_output = 1; break;
+            case 'I': args->io_engine = optarg; break;
+            case 'K': args->kernel = optarg; break;
+            case 'T': args->threads = parse_thread_count(optarg); break;
+            case 'F': args->range_offset = parse_byte_count(optarg); break;
+            case 'L': args->range_length = parse_byte_count(optarg); break;
             case 'h': args->help_requested = 1; print_help(argv[0]); return 0;
             default:
                 fprintf(stderr, ERR_INVALID_ARGS);
@@ -83,7 +150,7 @@ int validate_arguments(const ProgramArgs *args) {
     }
     
     // Validate required parameters
-    if (!args->embed_mode && !args->extract_mode) {
+    if (!args->embed_mode && !args->extract_mode && !args->info_mode) {
         fprintf(stderr, ERR_FLAG_REQUIRED);
         return 0;
     }
@@ -102,20 +169,30 @@ int validate_arguments(const ProgramArgs *args) {
         return 0;
     }
     
-    if (!args->output_file) {
+    // -info only reads the payload header: no output file, and the algorithm can be detected
+    if (!args->output_file && !args->info_mode) {
         fprintf(stderr, ERR_OUT_PARAMETER_REQUIRED);
         return 0;
     }
     
-    if (!args->steg_algorithm) {
+    // stdin can only feed one of the inputs
+    if (args->embed_mode && strcmp(args->input_file, STDIO_PATH) == 0 && strcmp(args->bitmap_file, STDIO_PATH) == 0) {
+        fprintf(stderr, ERR_STDIN_TWICE);
+        return 0;
+    }
+
+    if (!args->steg_algorithm && !args->info_mode) {
         fprintf(stderr, ERR_STEG_PARAMETER_REQUIRED);
         return 0;
     }
     
     // Validate steganography algorithm
-    if (strcmp(args->steg_algorithm, "LSB1") != 0 && 
-        strcmp(args->steg_algorithm, "LSB4") != 0 && 
-        strcmp(args->steg_algorithm, "LSBI") != 0) {
+    if (args->steg_algorithm && strcmp(args->steg_algorithm, STEG_AUTO) == 0) {
+        if (args->embed_mode) {
+            fprintf(stderr, ERR_STEG_AUTO_EMBED);
+            return 0;
+        }
+    } else if (args->steg_algorithm && !find_stego_algorithm(args->steg_algorithm)) {
         fprintf(stderr, ERR_INVALID_STEG_ALGORITHM, args->steg_algorithm);
         return 0;
     }
@@ -142,6 +219,49 @@ int validate_arguments(const ProgramArgs *args) {
         }
     }
     
+    // Validate I/O engine if provided
+    if (args->io_engine) {
+        if (strcmp(args->io_engine, "mmap") != 0 &&
+            strcmp(args->io_engine, "uring") != 0 &&
+            strcmp(args->io_engine, "threads") != 0) {
+            fprintf(stderr, ERR_INVALID_IO_ENGINE, args->io_engine);
+            return 0;
+        }
+    }
+
+    // Validate kernel level if provided (CPU support is checked when it is bound)
+    if (args->kernel) {
+        if (strcmp(args->kernel, "auto") != 0 &&
+            strcmp(args->kernel, "scalar") != 0 &&
+            strcmp(args->kernel, "sse") != 0 &&
+            strcmp(args->kernel, "avx2") != 0 &&
+            strcmp(args->kernel, "avx512") != 0) {
+            fprintf(stderr, ERR_INVALID_KERNEL, args->kernel);
+            return 0;
+        }
+    }
+
+    if (args->threads < 0) {
+        fprintf(stderr, ERR_INVALID_THREADS, MAX_THREADS);
+        return 0;
+    }
+
+    // Range extraction: plain payloads only (the file bytes are not addressable inside the ciphertext)
+    if (args->range_offset != -1 || args->range_length != -1) {
+        if (!args->extract_mode) {
+            fprintf(stderr, ERR_RANGE_EXTRACT_ONLY);
+            return 0;
+        }
+        if (args->range_offset == -2 || args->range_length == -2 || args->range_length == 0) {
+            fprintf(stderr, ERR_INVALID_RANGE);
+            return 0;
+        }
+        if (args->password) {
+            fprintf(stderr, ERR_RANGE_ENCRYPTED);
+            return 0;
+        }
+    }
+
     // Check if password is provided when encryption is specified
     if ((args->encryption_algo || args->mode) && !args->password) {
         fprintf(stderr, "Error: Password (-pass) is required when specifying an algorithm (-a) or mode (-m).\n");
@@ -154,7 +274,7 @@ int validate_arguments(const ProgramArgs *args) {
 void debug_arguments(const ProgramArgs *args) {
     // Print parsed parameters for debugging
     printf("Program parameters:\n");
-    printf("  Mode: %s\n", args->embed_mode ? "embed" : "extract");
+    printf("  Mode: %s\n", args->embed_mode ? "embed" : (args->info_mode ? "info" : "extract"));
     printf("  Input file: %s\n", args->input_file);
     printf("  Bitmap file: %s\n", args->bitmap_file);
     printf("  Output file: %s\n", args->output_file);
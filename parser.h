@@ -1,17 +1,30 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdint.h>
+
+#define MAX_THREADS 256  // Upper bound for -threads
+#define STEG_AUTO "auto" // -steg value that detects the algorithm (extract and info only)
+
 // Structure to hold all program parameters
 typedef struct {
     int embed_mode;           // 1 if -embed is specified
     int extract_mode;         // 1 if -extract is specified
+    int info_mode;            // 1 if -info is specified (print the payload size and extension only)
+    int json_output;          // 1 if -json is specified (-info output as JSON)
     char *input_file;         // -in file
     char *bitmap_file;        // -p bitmapfile
     char *output_file;        // -out bitmapfile
-    char *steg_algorithm;     // -steg <LSB1|LSB4|LSBI>
+    char *steg_algorithm;     // -steg <LSB1|LSB2|LSB3|LSB4|LSBI|auto>
     char *encryption_algo;    // -a <aes128|aes192|aes256|3des>
     char *mode;              // -m <ecb|cfb|ofb|cbc>
     char *password;          // -pass password
+    int clone_output;        // 1 if -clone is specified (reflink the carrier, rewrite only modified pages)
+    char *io_engine;         // -io <mmap|uring|threads>
+    char *kernel;            // -kernel <auto|scalar|sse|avx2|avx512>
+    int threads;             // -threads N (0 = not given, -1 = not a valid count)
+    int64_t range_offset;    // -offset X, first byte of the hidden file to extract (-1 = not given, -2 = invalid)
+    int64_t range_length;    // -length N, bytes to extract from range_offset (-1 = not given, -2 = invalid)
     int help_requested;      // 1 if help is requested
 } ProgramArgs;
 
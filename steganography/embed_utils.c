@@ -1,22 +1,79 @@
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+
 #include "embed_utils.h"
 #include "../error.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+/**
+ * @brief Opens the secret file. STDIO_PATH is stdin: used as is when it is a regular file,
+ * otherwise (pipe) spooled into an anonymous temporary file, so that its size is known
+ * before the size header is embedded and the data can be read at any offset.
+ * @return The open file, or NULL on error (errno set).
+ */
+static FILE *open_secret_file(const char *in_file) {
+    if (strcmp(in_file, STDIO_PATH) != 0) {
+        return fopen(in_file, "rb");
+    }
+
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+        int fd = dup(STDIN_FILENO);
+        return fd < 0 ? NULL : fdopen(fd, "rb");
+    }
 
+    FILE *spool = tmpfile();
+    if (!spool) {
+        return NULL;
+    }
+    unsigned char block[64 * 1024];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), stdin)) > 0) {
+        if (fwrite(block, 1, n, spool) != n) {
+            fclose(spool);
+            return NULL;
+        }
+    }
+    if (ferror(stdin)) {
+        fclose(spool);
+        return NULL;
+    }
+    return spool;
+}
 
 FILE *get_file_metadata(const char *in_file, SecretFileMetadata *metadata) {
-    FILE *secret_fp = fopen(in_file, "rb");
+    FILE *secret_fp = open_secret_file(in_file);
     if (!secret_fp) {
         perror(in_file);
         return NULL;
     }
 
-    fseek(secret_fp, 0, SEEK_END);
-    metadata->file_size = ftell(secret_fp);
-    fseek(secret_fp, 0, SEEK_SET);
+    // Large-file offsets: secrets over 2 GB must not go through a 32-bit long
+    off_t file_size = -1;
+    if (fseeko(secret_fp, 0, SEEK_END) == 0) {
+        file_size = ftello(secret_fp);
+    }
+    if (file_size < 0 || fseeko(secret_fp, 0, SEEK_SET) != 0) {
+        perror(in_file);
+        fclose(secret_fp);
+        return NULL;
+    }
+    if ((uint64_t)file_size > UINT32_MAX) {
+        fprintf(stderr, "Error: Secret file '%s' exceeds the 4 GB limit of the size header.\n", in_file);
+        fclose(secret_fp);
+        return NULL;
+    }
+    metadata->file_size = (uint64_t)file_size;
 
-    char *ext = strrchr(in_file, '.');
+    char *ext = strcmp(in_file, STDIO_PATH) == 0 ? STDIN_SECRET_EXT : strrchr(in_file, '.');
     if (!ext) {
         ext = "";
     }
@@ -38,43 +95,122 @@ void write_size_header(unsigned char *buffer, long file_size) {
     buffer[3] = (size_be >> 0) & 0xFF; // LSB
 }
 
-unsigned char *build_secret_buffer(const char *in_file, size_t *required_buffer_len) {
-    SecretFileMetadata metadata;
-    FILE *secret_fp = NULL;
-    unsigned char *data_buffer = NULL;
-    size_t total_len;
-
-    secret_fp = get_file_metadata(in_file, &metadata);
-    if (!secret_fp) {
-        return NULL;
+/**
+ * @brief State of a streamed secret: the file, and the header and extension around its data.
+ */
+typedef struct {
+    FILE *fp;
+    int fd;
+    uint64_t file_size;
+    unsigned char header[sizeof(uint32_t)];
+    const char *ext;
+    size_t ext_len;
+} SecretFileSource;
+
+/**
+ * @brief read_at of streamed secrets: the header and extension come from memory, the data
+ * from the file with pread (no shared file offset, so workers can read concurrently).
+ */
+static int secret_file_read_at(PayloadSource *source, uint64_t offset, unsigned char *out, size_t len) {
+    SecretFileSource *secret = (SecretFileSource *)source->state;
+    const uint64_t data_end = sizeof(uint32_t) + secret->file_size;
+
+    while (len > 0) {
+        size_t n;
+        if (offset < sizeof(uint32_t)) {
+            n = sizeof(uint32_t) - (size_t)offset;
+            n = n < len ? n : len;
+            memcpy(out, secret->header + offset, n);
+        } else if (offset < data_end) {
+            n = data_end - offset < len ? (size_t)(data_end - offset) : len;
+            ssize_t got = pread(secret->fd, out, n, (off_t)(offset - sizeof(uint32_t)));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return -1;  // Error, or the file shrank since it was opened
+            }
+            n = (size_t)got;
+        } else {
+            uint64_t ext_offset = offset - data_end;
+            if (ext_offset >= secret->ext_len) {
+                return -1;
+            }
+            n = secret->ext_len - (size_t)ext_offset;
+            n = n < len ? n : len;
+            memcpy(out, secret->ext + ext_offset, n);
+        }
+        out += n;
+        offset += n;
+        len -= n;
     }
+    return 0;
+}
 
-    total_len = sizeof(uint32_t) + (size_t)metadata.file_size + metadata.ext_len;
-    *required_buffer_len = total_len;
+static void secret_file_close(PayloadSource *source) {
+    SecretFileSource *secret = (SecretFileSource *)source->state;
+    fclose(secret->fp);
+    free(secret);
+}
+
+int open_secret_source(const char *in_file, PayloadSource *source) {
+    SecretFileMetadata metadata;
 
-    data_buffer = (unsigned char *)calloc(1, total_len);
-    if (!data_buffer) {
+    memset(source, 0, sizeof(*source));
+    SecretFileSource *secret = calloc(1, sizeof(*secret));
+    if (!secret) {
         fprintf(stderr, "Error: Failed to allocate memory for the secret buffer.\n");
-        fclose(secret_fp);
-        return NULL;
+        return FALSE;
+    }
+    secret->fp = get_file_metadata(in_file, &metadata);
+    if (!secret->fp) {
+        free(secret);
+        return FALSE;
+    }
+    if (metadata.file_size > SIZE_MAX - sizeof(uint32_t) - metadata.ext_len) {
+        fprintf(stderr, "Error: Secret file '%s' is too large for this platform.\n", in_file);
+        fclose(secret->fp);
+        free(secret);
+        return FALSE;
     }
 
-    write_size_header(data_buffer, metadata.file_size);
-
+    secret->fd = fileno(secret->fp);
+    secret->file_size = metadata.file_size;
+    secret->ext = metadata.ext;
+    secret->ext_len = metadata.ext_len;
+    write_size_header(secret->header, (long)metadata.file_size);
+    // The embed walks the data front to back (LSBI twice): let the kernel read ahead
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(secret->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    source->len = sizeof(uint32_t) + (size_t)metadata.file_size + metadata.ext_len;
+    source->read_at = secret_file_read_at;
+    source->close = secret_file_close;
+    source->state = secret;
+    return TRUE;
+}
 
-    size_t data_start_offset = sizeof(uint32_t);
-    if (fread(data_buffer + data_start_offset, 1, (size_t)metadata.file_size, secret_fp) != (size_t)metadata.file_size) {
-        fprintf(stderr, "Error: Failed to read all data from file '%s'.\n", in_file);
-        free_secret_buffer(data_buffer);
-        fclose(secret_fp);
-        return NULL;
+int read_payload(PayloadSource *source, uint64_t offset, unsigned char *out, size_t len) {
+    if (offset > source->len || len > source->len - offset) {
+        memset(out, 0, len);
+        __atomic_store_n(&source->failed, 1, __ATOMIC_RELAXED);
+        return FALSE;
     }
+    if (source->read_at(source, offset, out, len) != 0) {
+        memset(out, 0, len);
+        __atomic_store_n(&source->failed, 1, __ATOMIC_RELAXED);
+        return FALSE;
+    }
+    return TRUE;
+}
 
-    size_t ext_start_offset = data_start_offset + metadata.file_size;
-    memcpy(data_buffer + ext_start_offset, metadata.ext, metadata.ext_len);
-
-    fclose(secret_fp);
-    return data_buffer;
+void close_payload_source(PayloadSource *source) {
+    if (source && source->close) {
+        source->close(source);
+        source->close = NULL;
+        source->state = NULL;
+    }
 }
 
 
@@ -84,23 +220,23 @@ int check_bmp_capacity(const BMPImage *image, size_t required_data_bits, int bit
         return FALSE;
     }
 
-    int pixel_count = get_pixel_count(image);
-
-    size_t capacity_bits = (size_t)pixel_count * bits_per_pixel;
+    uint64_t capacity_bits = get_capacity_bits(image, bits_per_pixel);
 
-    if (required_data_bits > capacity_bits) {
+    if ((uint64_t)required_data_bits > capacity_bits) {
         fprintf(stderr, ERR_INSUFFICIENT_CAPACITY);
-        fprintf(stderr, "Capacity: %zu bits. Required: %zu bits.\n", capacity_bits, required_data_bits);
+        fprintf(stderr, "Capacity: %" PRIu64 " bits. Required: %zu bits.\n", capacity_bits, required_data_bits);
         return FALSE;
     }
 
     return TRUE;
 }
 
-void free_secret_buffer(unsigned char *buffer) {
-    if (buffer) {
-        free(buffer);
+uint64_t get_capacity_bits(const BMPImage *image, int bits_per_pixel) {
+    int64_t pixel_count = get_pixel_count(image);
+    if (pixel_count <= 0 || bits_per_pixel <= 0) {
+        return 0;
     }
+    return (uint64_t)pixel_count * (uint64_t)bits_per_pixel;
 }
 
 int get_nth_bit(const unsigned char *data_buffer, size_t n) {
@@ -6,7 +6,10 @@
 #include "../bmp_lib.h"
 
 #define LSB1_BITS_PER_PIXEL 3
+#define LSB2_BITS_PER_PIXEL 6
+#define LSB3_BITS_PER_PIXEL 9
 #define LSB4_BITS_PER_PIXEL 12
+#define LSBN_MAX_BITS 4         // LSBn family: LSB1 .. LSB4
 #define LSBI_BITS_PER_PIXEL 2   // Because it does not use R
 #define LSBI_CONTROL_BITS 4
 
@@ -17,13 +20,34 @@
  * @brief Auxiliary structure to hold file size and extension details after I/O.
  */
 typedef struct {
-    long file_size;       // Tamaño real del archivo en bytes (para el campo DWORD)
+    uint64_t file_size;   // Tamaño real del archivo en bytes (para el campo DWORD)
     char *ext;            // Puntero a la extensión (ej: ".txt")
     size_t ext_len;       // Longitud de la extensión incluyendo '.' y '\0'
 } SecretFileMetadata;
 
+/**
+ * @brief The payload stream an embed hides (Size | Data | Ext, or Size | Ciphertext), read on
+ * demand from the secret file (and encrypted on the fly when a password is given).
+ *
+ * The embed callbacks only ask for the bytes of the pixels they are writing (read_payload),
+ * so a streamed secret is never loaded whole and memory stays bounded by the callbacks'
+ * scratch windows. Reads may come from several worker threads at once.
+ */
+typedef struct PayloadSource {
+    size_t len;                     // Total length of the stream in bytes
+    int (*read_at)(struct PayloadSource *source, uint64_t offset, unsigned char *out, size_t len);  // 0 or -1
+    void (*close)(struct PayloadSource *source);
+    void *state;                    // Private to read_at / close
+    int failed;                     // Set when a read fails during the embed (row callbacks cannot return errors)
+    int sequential;                 // read_at only moves forward cheaply (stepping back restarts it): walk rows on one thread
+} PayloadSource;
+
+#define STDIN_SECRET_EXT ".bin" // Extension recorded for a secret read from stdin (-in -)
+
 /**
  * @brief Reads the size and extension of the secret file.
+ * STDIO_PATH reads the secret from stdin (spooled to a temporary file when it is a pipe)
+ * and records STDIN_SECRET_EXT as its extension.
  *
  * @param in_file Path to the secret file.
  * @param metadata Pointer to the struct where results will be stored.
@@ -54,16 +78,38 @@ void write_size_header(unsigned char *buffer, long file_size);
 int check_bmp_capacity(const BMPImage *image, size_t required_data_bits, int bits_per_pixel);
 
 /**
- * @brief Constructs the final secret buffer (Size|Data|Ext) ready for steganography
+ * @brief Total number of bits the carrier can hide at bits_per_pixel bits per pixel (64-bit math).
  *
- * The format is: Real Size (4 bytes, Big Endian) || Data || .ext\0
- * NOTE: This function allocates memory for the buffer, which MUST be freed by the caller
+ * @param image Pointer to the initialized BMPImage structure.
+ * @param bits_per_pixel The number of bits the algorithm hides per pixel (e.g., 3 for LSB1).
+ * @return Capacity in bits, 0 on invalid image.
+ */
+uint64_t get_capacity_bits(const BMPImage *image, int bits_per_pixel);
+
+/**
+ * @brief Opens the secret file as a streamed payload source (Size | Data | Ext).
+ *
+ * The size header comes from the file size and the extension from the name; the data is
+ * read with pread as the embed reaches it (sequential read-ahead is requested), so nothing
+ * of the file is buffered up front. Release with close_payload_source.
  *
  * @param in_file Path to the secret file
- * @param required_buffer_len Pointer to store the total length of the constructed buffer in bytes
- * @return Pointer to the allocated and filled secret buffer, or NULL on error
+ * @param source Filled with the streamed source
+ * @return TRUE on success, FALSE on error (printed)
  */
-unsigned char *build_secret_buffer(const char *in_file, size_t *required_buffer_len);
+int open_secret_source(const char *in_file, PayloadSource *source);
+
+/**
+ * @brief Copies stream bytes [offset, offset + len) into out through source->read_at.
+ * On a read error out is zero-filled and source->failed is set.
+ * @return TRUE on success, FALSE on error.
+ */
+int read_payload(PayloadSource *source, uint64_t offset, unsigned char *out, size_t len);
+
+/**
+ * @brief Releases what the source's opener acquired (no-op once closed).
+ */
+void close_payload_source(PayloadSource *source);
 
 /**
  * @brief Retrieves the N-th bit (0-indexed, LSB first) from the data buffer.
@@ -74,13 +120,4 @@ unsigned char *build_secret_buffer(const char *in_file, size_t *required_buffer_
  */
 int get_nth_bit(const unsigned char *data_buffer, size_t n);
 
-/**
- * @brief Frees the memory allocated for the secret buffer.
- * * Should be called by the module responsible for consuming the buffer
- * after the embedding process is complete.
- *
- * @param buffer Pointer to the secret buffer to free.
- */
-void free_secret_buffer(unsigned char *buffer);
-
 #endif
\ No newline at end of file
@@ -1,8 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "extract_utils.h"
 #include "embed_utils.h"
+#include "lsb_kernels.h"
 #include <string.h>
+
+#define EXTRACT_CHUNK_BYTES 4096 // Payload bytes decoded per gathered chunk (block extraction)
+
 /**
  * @brief Reconstructs a 4-byte Big Endian size from an unsigned char buffer.
  * (Inverse of write_size_header)
@@ -16,147 +24,242 @@ uint32_t read_size_header(unsigned char *buffer) {
 }
 
 
-int extract_next_bit(BMPImage *image, int *bit_count, Pixel *current_pixel) {
-    int bit = 0;
-    unsigned char *component;
+int gather_components(const BMPImage *image, uint64_t first_component, unsigned char *out, size_t count) {
+    uint64_t total = (uint64_t)get_loaded_pixel_count(image) * 3;
+    if (first_component > total || count > total - first_component) {
+        return -1;
+    }
 
-    // Determine which component (B, G, R) to read from
-    int component_idx = (*bit_count) % 3;
-    // Read a new pixel if we've used all 3 components of the current one
-    if (component_idx == 0) {
-        if (fread(current_pixel, sizeof(Pixel), 1, image->in) != 1) {
-            
-            fprintf(stderr, "Error: Failed to read pixel data during extraction.\n");
-            return -1; // Read error
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t pixel = first_component / 3;
+    size_t channel = (size_t)(first_component % 3);
+    size_t column = (size_t)(pixel % image->width);
+    const Pixel *first = get_pixel(image, (size_t)pixel);  // NULL if its row was released
+    if (!first) {
+        return -1;
+    }
+    const unsigned char *row_start = (const unsigned char *)first - column * image->bytes_per_pixel;
+
+    for (; count > 0; row_start += image->row_stride, column = 0, channel = 0) {
+        if (image->bytes_per_pixel == BGR_PIXEL_SIZE) {
+            // 24-bit rows hold their components back to back
+            size_t available = ((size_t)image->width - column) * BGR_PIXEL_SIZE - channel;
+            size_t n = count < available ? count : available;
+            memcpy(out, row_start + column * BGR_PIXEL_SIZE + channel, n);
+            out += n;
+            count -= n;
+            continue;
         }
 
+        const unsigned char *pixel_ptr = row_start + column * image->bytes_per_pixel;
+        for (; column < image->width && count > 0; column++, pixel_ptr += image->bytes_per_pixel, channel = 0) {
+            for (; channel < 3 && count > 0; channel++, count--) {
+                *out++ = pixel_ptr[channel];
+            }
+        }
     }
 
-    if (component_idx == 0) component = &(current_pixel->blue);
-    else if (component_idx == 1) component = &(current_pixel->green);
-    else component = &(current_pixel->red);
+    return 0;
+}
 
-    // Extract the LSB
-    bit = (*component) & 1;
+int extract_lsbn_block(BMPImage *image, int bits_per_component, uint64_t *bit_count, unsigned char *out, size_t len) {
+    unsigned char components[EXTRACT_CHUNK_BYTES * 8];
+    const uint64_t n = (uint64_t)bits_per_component;
 
-    (*bit_count)++;
-    return bit;
+    while (len > 0) {
+        size_t chunk = len < EXTRACT_CHUNK_BYTES ? len : EXTRACT_CHUNK_BYTES;
+        uint64_t first_component = *bit_count / n;
+        size_t first_bit = (size_t)(*bit_count % n);
+        size_t count = (size_t)((first_bit + (uint64_t)chunk * 8 + n - 1) / n);
+        if (gather_components(image, first_component, components, count) != 0) {
+            fprintf(stderr, "Error: Failed to read pixel data during extraction.\n");
+            return -1;
+        }
+        lsbn_extract_bytes(bits_per_component, components, first_bit, out, chunk);
+        *bit_count += (uint64_t)chunk * 8;
+        out += chunk;
+        len -= chunk;
+    }
+    return 0;
 }
 
-int write_secret_from_buffer(const char *out_base_path, unsigned char *buffer, size_t buffer_len, size_t extension_len) {
-    const unsigned char *data_ptr = buffer;
-    const unsigned char *ext_ptr = data_ptr + buffer_len;
+int extract_lsbi_block(BMPImage *image, uint64_t *bit_count, const LSBITables *tables, unsigned char *out, size_t len) {
+    enum { CHUNK_PIXELS = EXTRACT_CHUNK_BYTES * 2 };    // Multiple of 16 (one SSSE3 block)
+    unsigned char components[CHUNK_PIXELS * 3];
+    unsigned char packed[CHUNK_PIXELS / 4];
 
-    size_t base_len = strlen(out_base_path);
-    char *full_out_path = malloc(base_len + extension_len + 1);
-    if (!full_out_path) {
-        fprintf(stderr, "Error: Failed to allocate memory for output path.\n");
-        return 1;
+    if (len == 0) {
+        return 0;
     }
-    memcpy(full_out_path, out_base_path, base_len);
-    memcpy(full_out_path + base_len, ext_ptr, extension_len);
 
-    FILE *out_fp = fopen(full_out_path, "wb");
-    if (!out_fp) {
-        perror(full_out_path);
-        free(full_out_path);
-        return 1;
+    // Position in the B/G bit stream: a pending Red is skipped, a pending Green drops one bit
+    uint64_t component = *bit_count;
+    if (component % 3 == 2) {
+        component++;
     }
+    uint64_t pixel = component / 3;
+    unsigned skip = (unsigned)(component % 3);
+    uint64_t pixels_left = ((uint64_t)len * 8 + skip + 1) / 2;
+
+    uint64_t acc = 0;
+    unsigned acc_bits = 0;
+    size_t produced = 0;
+
+    while (pixels_left > 0) {
+        size_t n = pixels_left < CHUNK_PIXELS ? (size_t)pixels_left : CHUNK_PIXELS;
+        size_t rounded = (n + 3) & ~(size_t)3;
+        if (gather_components(image, pixel * 3, components, n * 3) != 0) {
+            fprintf(stderr, "Error: Failed to read pixel data during extraction.\n");
+            return -1;
+        }
+        memset(components + n * 3, 0, (rounded - n) * 3);
+        lsbi_decode_pixels(components, rounded, packed, tables);
+
+        // Re-align the pixel-aligned stream to the payload bytes
+        for (size_t i = 0; i < rounded / 4 && produced < len; i++) {
+            acc = (acc << 8) | packed[i];
+            acc_bits += 8 - skip;
+            skip = 0;
+            while (acc_bits >= 8 && produced < len) {
+                out[produced++] = (unsigned char)(acc >> (acc_bits - 8));
+                acc_bits -= 8;
+            }
+        }
 
-    if (fwrite(data_ptr, 1, buffer_len, out_fp) != buffer_len) {
-        fprintf(stderr, "Error: Failed to write all data to output file.\n");
-        fclose(out_fp);
-        free(full_out_path);
-        return 1;
+        pixel += n;
+        pixels_left -= n;
     }
 
-    printf("File successfully extracted to: %s\n", full_out_path);
-    
-    fclose(out_fp);
-    free(full_out_path);
-    return 0; // Success
+    // Next component after the last data bit used
+    uint64_t last_bit = 2 * (component / 3) + component % 3 + (uint64_t)len * 8 - 1;
+    *bit_count = (last_bit / 2) * 3 + last_bit % 2 + 1;
+    return 0;
 }
 
-unsigned char extract_nibble(BMPImage *image, int *bit_count, Pixel *current_pixel) {
-    unsigned char *component;
-    int component_idx = (*bit_count) % 3; // 0=B, 1=G, 2=R
+int open_secret_sink(const char *out_base_path, SecretFileSink *sink) {
+    static const char suffix[] = ".XXXXXX";
+    size_t base_len = strlen(out_base_path);
 
-    if (component_idx == 0) {
-        if (fread(current_pixel, sizeof(Pixel), 1, image->in) != 1) {
-            fprintf(stderr, "Error: Falló la lectura de píxel durante la extracción LSB4.\n");
-            return 0xFF;
-        }
+    memset(sink, 0, sizeof(*sink));
+    if (strcmp(out_base_path, STDIO_PATH) == 0) {
+        sink->fp = stdout;
+        sink->to_stdout = 1;
+        return 0;
+    }
+    sink->temp_path = malloc(base_len + sizeof(suffix));
+    if (!sink->temp_path) {
+        fprintf(stderr, "Error: Failed to allocate memory for output path.\n");
+        return -1;
+    }
+    memcpy(sink->temp_path, out_base_path, base_len);
+    memcpy(sink->temp_path + base_len, suffix, sizeof(suffix));
+
+    int fd = mkstemp(sink->temp_path);
+    if (fd < 0) {
+        perror(sink->temp_path);
+        free(sink->temp_path);
+        sink->temp_path = NULL;
+        return -1;
     }
 
-    if (component_idx == 0) component = &(current_pixel->blue);
-    else if (component_idx == 1) component = &(current_pixel->green);
-    else component = &(current_pixel->red);
-
-    unsigned char nibble = (*component) & 0x0F;
-
-    (*bit_count)++;
+    // mkstemp creates 0600: give the file the permissions fopen would have
+    mode_t mask = umask(0);
+    umask(mask);
+    if (fchmod(fd, 0666 & ~mask) != 0) {
+        perror(sink->temp_path);
+        close(fd);
+        unlink(sink->temp_path);
+        free(sink->temp_path);
+        sink->temp_path = NULL;
+        return -1;
+    }
 
-    return nibble;
+    sink->fp = fdopen(fd, "wb");
+    if (!sink->fp) {
+        perror(sink->temp_path);
+        close(fd);
+        unlink(sink->temp_path);
+        free(sink->temp_path);
+        sink->temp_path = NULL;
+        return -1;
+    }
+    return 0;
 }
 
+int write_secret_chunk(void *sink, const unsigned char *data, size_t len) {
+    SecretFileSink *file_sink = (SecretFileSink *)sink;
 
-int extract_msb_byte(BMPImage *image, int *bit_count, Pixel *current_pixel, unsigned char inversion_map, int (*bit_extractor)(BMPImage *, int *, Pixel *, unsigned char)) {
-    unsigned char assembled_byte = 0;
-
-    for (int i = 0; i < 8; i++) {
-        int bit = bit_extractor(image, bit_count, current_pixel, inversion_map);
-        if (bit == -1) return -1;
-
-        size_t bit_pos = 7 - i;
-        if (bit) {
-            assembled_byte |= (1 << bit_pos);
-        }
+    if (fwrite(data, 1, len, file_sink->fp) != len) {
+        fprintf(stderr, "Error: Failed to write all data to output file.\n");
+        return -1;
     }
-    return (int)assembled_byte;
+    return 0;
 }
 
-/**
- * @brief Extrae el siguiente bit de datos aplicando las reglas LSBI (MSB-First, Salto R, Re-inversión).
- * * @param image Puntero al BMPImage.
- * @param bit_count Puntero al contador de componentes (0=B, 1=G, 2=R).
- * @param current_pixel Puntero al píxel actual.
- * @param inversion_map Mapa de 4 bits para la lógica de inversión condicional.
- * @return El bit de secreto final (0 o 1), o -1 en caso de error de lectura.
- */
-int lsbi_extract_data_bit(BMPImage *image, int *bit_count, Pixel *current_pixel, unsigned char inversion_map) {
-
-    unsigned char stego_value;
-    int extracted_lsb, secret_bit;
-
-    // 1. Saltar Canal Rojo (R, índice 2) y leer/avanzar al componente B o G
-    do {
-        int component_idx = (*bit_count) % 3;
-
-        // Si estamos en el canal Azul (indice 0), leemos un nuevo píxel
-        if (component_idx == 0) {
-            if (fread(current_pixel, sizeof(Pixel), 1, image->in) != 1) return -1;
+int finish_secret_sink(SecretFileSink *sink, const char *out_base_path, const char *extension) {
+    if (sink->to_stdout) {
+        sink->fp = NULL;
+        if (fflush(stdout) != 0) {
+            fprintf(stderr, "Error: Failed to write all data to output file.\n");
+            return -1;
         }
+        fprintf(stderr, "File successfully extracted to standard output (extension: %s)\n", extension);
+        return 0;
+    }
 
-        if (component_idx == 2) { // Canal R: saltar y avanzar
-            (*bit_count)++;
-            continue;
-        }
-
-        // Asignar puntero al componente B o G
-        unsigned char *component_ptr = (component_idx == 0) ? &(current_pixel->blue) : &(current_pixel->green);
-        stego_value = *component_ptr;
-
-        extracted_lsb = stego_value & 1; // Extraer LSB
+    size_t base_len = strlen(out_base_path);
+    size_t extension_len = strlen(extension);
+    char *full_out_path = malloc(base_len + extension_len + 1);
+    if (!full_out_path) {
+        fprintf(stderr, "Error: Failed to allocate memory for output path.\n");
+        discard_secret_sink(sink);
+        return -1;
+    }
+    memcpy(full_out_path, out_base_path, base_len);
+    memcpy(full_out_path + base_len, extension, extension_len + 1);
 
-        (*bit_count)++; // Avanzar al siguiente componente
-        break;
-    } while (1);
+    int closed = fclose(sink->fp);
+    sink->fp = NULL;
+    if (closed != 0) {
+        fprintf(stderr, "Error: Failed to write all data to output file.\n");
+        discard_secret_sink(sink);
+        free(full_out_path);
+        return -1;
+    }
+    if (rename(sink->temp_path, full_out_path) != 0) {
+        perror(full_out_path);
+        discard_secret_sink(sink);
+        free(full_out_path);
+        return -1;
+    }
 
-    // 2. Lógica LSBI de Re-Inversión Condicional
-    unsigned char pattern = (stego_value >> 1) & 0x03; // Extraer Bits 1 y 2
-    unsigned char inversion_flag = (inversion_map >> pattern) & 1;
+    printf("File successfully extracted to: %s\n", full_out_path);
 
-    secret_bit = (inversion_flag) ? (extracted_lsb ^ 1) : extracted_lsb; // Re-invertir si el flag está activo
+    free(sink->temp_path);
+    sink->temp_path = NULL;
+    free(full_out_path);
+    return 0; // Success
+}
 
-    return secret_bit;
-}
\ No newline at end of file
+void discard_secret_sink(SecretFileSink *sink) {
+    if (sink->to_stdout) {
+        // What already reached stdout cannot be taken back
+        if (sink->fp) {
+            fflush(stdout);
+            sink->fp = NULL;
+        }
+        return;
+    }
+    if (sink->fp) {
+        fclose(sink->fp);
+        sink->fp = NULL;
+    }
+    if (sink->temp_path) {
+        unlink(sink->temp_path);
+        free(sink->temp_path);
+        sink->temp_path = NULL;
+    }
+}
@@ -2,7 +2,9 @@
 #define EXTRACT_UTILS_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include "../bmp_lib.h"
+#include "lsb_kernels.h"
 
 
 
@@ -15,52 +17,86 @@
  */
 uint32_t read_size_header(unsigned char *buffer);
 
- /**
- * @brief Helper to read a single bit from the image stream.
- * @param image The BMPImage.
- * @param bit_count A pointer to the current bit counter (0-2).
- * @param current_pixel A pointer to the current pixel being read.
- * @return The extracted bit (0 or 1), or -1 on read error.
+/**
+ * @brief Output of a streamed extraction: a temporary file next to the final one, written
+ * chunk by chunk as the payload is decoded and renamed once the extension is known, so a
+ * failed extraction never leaves a partial file behind. With STDIO_PATH the data goes
+ * straight to stdout instead (the extension is only reported).
  */
- int extract_next_bit(BMPImage *image, int *bit_count, Pixel *current_pixel);
+typedef struct {
+    FILE *fp;
+    char *temp_path;        // "<out_base_path>.XXXXXX" until finish_secret_sink renames it
+    int to_stdout;          // 1 if fp is stdout (no temporary file)
+} SecretFileSink;
 
- /**
- * @brief Writes a secret from a buffer to a file.
- * @param out_base_path The base path for the output file.
- * @param buffer The buffer containing the secret.
- * @param buffer_len The length of the buffer.
- * @return 0 on success, 1 on error.
+/**
+ * @brief Creates the temporary output file for out_base_path (same directory, so the final
+ * rename does not copy), or binds the sink to stdout for STDIO_PATH.
+ * @param out_base_path The base path for the output file (the extension is added later).
+ * @param sink Filled with the open temporary file.
+ * @return 0 on success, -1 on error (printed).
  */
- int write_secret_from_buffer(const char *out_base_path, unsigned char *buffer, size_t buffer_len,size_t extension_len);
+int open_secret_sink(const char *out_base_path, SecretFileSink *sink);
 
 /**
- * @brief Extracts the 4 Least Significant Bits (LSBs) from the next color component.
- * * Reads the LSB nibble (4 bits) from the next color component (Blue, Green, or Red)
- * in sequence, advancing the component counter. Reads a new pixel when transitioning
- * from Red to Blue.
- * @param image Pointer to the BMPImage structure.
- * @param bit_count Pointer to the component counter (0=B, 1=G, 2=R).
- * @param current_pixel Pointer to the current Pixel data structure.
- * @return The extracted nibble (0x00 - 0x0F), or 0xFF on read error (e.g., EOF).
+ * @brief Appends decoded bytes to the temporary file (a payload_sink_func_t).
+ * @param sink The SecretFileSink.
+ * @param data Decoded bytes.
+ * @param len Number of bytes.
+ * @return 0 on success, -1 on write error (printed).
  */
-unsigned char extract_nibble(BMPImage *image, int *bit_count, Pixel *current_pixel);
+int write_secret_chunk(void *sink, const unsigned char *data, size_t len);
 
 /**
- * @brief Extrae un byte completo utilizando una función auxiliar de extracción de bits.
- * @param bit_extractor La función a usar para obtener el siguiente bit (ej: lsbi_extract_data_bit).
- * @return El byte ensamblado (MSB-first), o -1 en caso de error.
+ * @brief Closes the temporary file and renames it to out_base_path + extension.
+ * @param sink The SecretFileSink (discarded on error).
+ * @param out_base_path The base path given to open_secret_sink.
+ * @param extension The extension read from the payload (e.g. ".txt"), '\0'-terminated.
+ * @return 0 on success, -1 on error (printed).
  */
-int extract_msb_byte(BMPImage *image, int *bit_count, Pixel *current_pixel, unsigned char inversion_map, int (*bit_extractor)(BMPImage *, int *, Pixel *, unsigned char));
+int finish_secret_sink(SecretFileSink *sink, const char *out_base_path, const char *extension);
 
+/**
+ * @brief Closes and deletes the temporary file of an unfinished extraction (no-op once finished).
+ */
+void discard_secret_sink(SecretFileSink *sink);
+
+/**
+ * @brief Copies `count` color components, starting at component index first_component, into out.
+ * Components follow the extraction order (B,G,R per pixel, storage order), with row
+ * padding and the alpha byte of 32-bit pixels left out.
+ * @param image The BMPImage.
+ * @param first_component Index of the first component (the value of the component counter).
+ * @param out Destination buffer (count bytes).
+ * @param count Number of components to copy.
+ * @return 0 on success, -1 if the range runs past the end of the pixel array (or of the rows
+ * loaded so far, for a streamed carrier).
+ */
+int gather_components(const BMPImage *image, uint64_t first_component, unsigned char *out, size_t count);
+
+/**
+ * @brief Extracts `len` whole LSBn bytes (n = bits_per_component) starting at stream bit *bit_count.
+ * Components are gathered in chunks and decoded by lsbn_extract_bytes (vectorized for
+ * LSB1/LSB4, word-level on the scalar path); *bit_count advances by 8 * len. Also used one
+ * byte at a time for the header and the extension.
+ * @param image The BMPImage.
+ * @param bits_per_component Payload bits per component (1-4).
+ * @param bit_count A pointer to the 64-bit position in the payload bit stream (component = bit / n).
+ * @param out Destination buffer (len bytes).
+ * @param len Number of payload bytes to extract.
+ * @return 0 on success, -1 on read error (payload runs past the end of the image).
+ */
+int extract_lsbn_block(BMPImage *image, int bits_per_component, uint64_t *bit_count, unsigned char *out, size_t len);
 
 /**
- * @brief Extrae el siguiente bit de datos aplicando las reglas LSBI (MSB-First, Salto R, Re-inversión).
- * * @param image Puntero al BMPImage.
- * @param bit_count Puntero al contador de componentes (0=B, 1=G, 2=R).
- * @param current_pixel Puntero al píxel actual.
- * @param inversion_map Mapa de 4 bits para la lógica de inversión condicional.
- * @return El bit de secreto final (0 o 1), o -1 en caso de error de lectura.
+ * @brief Extracts `len` whole LSBI bytes starting at the current component, in blocks.
+ * Pixels are gathered in chunks and decoded two bits at a time (Blue, Green) through the
+ * lookup tables of the inversion map (lsbi_decode_pixels); Red is skipped.
+ * The tables are built once per extraction by the caller (lsbi_build_tables). A pending Red or
+ * Green position in *bit_count is honoured, and *bit_count is left right after the last
+ * data bit used.
+ * @return 0 on success, -1 on read error (payload runs past the end of the image).
  */
-int lsbi_extract_data_bit(BMPImage *image, int *bit_count, Pixel *current_pixel, unsigned char inversion_map);
+int extract_lsbi_block(BMPImage *image, uint64_t *bit_count, const LSBITables *tables, unsigned char *out, size_t len);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,873 @@
+#include "lsb_kernels.h"
+#include "embed_utils.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define LSB_KERNELS_X86 1
+#endif
+
+// -------------------------------------- Scalar --------------------------------------
+
+/**
+ * @brief Loads 8 consecutive components as a little-endian word (component i in byte i),
+ * whatever the host byte order; compilers turn this into a single load.
+ */
+static inline uint64_t load_components64(const unsigned char *components) {
+    return (uint64_t)components[0] | ((uint64_t)components[1] << 8) | ((uint64_t)components[2] << 16) |
+           ((uint64_t)components[3] << 24) | ((uint64_t)components[4] << 32) | ((uint64_t)components[5] << 40) |
+           ((uint64_t)components[6] << 48) | ((uint64_t)components[7] << 56);
+}
+
+/**
+ * @brief Reference LSB1 loop: one payload bit per component.
+ */
+static void lsb1_embed_scalar(unsigned char *carrier, const unsigned char *payload, size_t first_bit, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        carrier[i] = (carrier[i] & 0xFE) | get_nth_bit(payload, first_bit + i);
+    }
+}
+
+/**
+ * @brief Byte-aligned LSB1: payload byte j goes into carrier[8j .. 8j+7], MSB first.
+ */
+static void lsb1_embed_aligned_scalar(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    for (size_t j = 0; j < payload_bytes; j++, carrier += 8) {
+        unsigned char byte = payload[j];
+        for (int b = 0; b < 8; b++) {
+            carrier[b] = (carrier[b] & 0xFE) | ((byte >> (7 - b)) & 1);
+        }
+    }
+}
+
+/**
+ * @brief Word-level LSB1 extract: 8 components -> 1 payload byte, MSB first (8 pixels -> 3 bytes).
+ * The 8 LSBs are masked in one word and gathered into its top byte with a single multiply:
+ * the LSB of component i lands on bit 63 - i, with no carries between the partial products.
+ */
+static void lsb1_extract_scalar(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    for (size_t j = 0; j < payload_bytes; j++, components += 8) {
+        uint64_t lsbs = load_components64(components) & 0x0101010101010101ULL;
+        payload[j] = (unsigned char)((lsbs * 0x8040201008040201ULL) >> 56);
+    }
+}
+
+/**
+ * @brief Reference LSB4 loop: one payload nibble per component.
+ */
+static void lsb4_embed_scalar(unsigned char *carrier, const unsigned char *payload, size_t first_nibble, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        size_t nibble_idx = first_nibble + i;
+        unsigned char byte = payload[nibble_idx / 2];
+        unsigned char nibble = (nibble_idx % 2 == 0) ? (byte >> 4) : (byte & 0x0F);
+        carrier[i] = (carrier[i] & 0xF0) | nibble;
+    }
+}
+
+/**
+ * @brief Byte-aligned LSB4: payload byte j goes into carrier[2j] (high nibble) and carrier[2j + 1].
+ */
+static void lsb4_embed_aligned_scalar(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    lsb4_embed_scalar(carrier, payload, 0, payload_bytes * 2);
+}
+
+/**
+ * @brief Word-level LSB4 extract: 8 components -> 4 payload bytes, high nibble first (8 pixels -> 12 bytes).
+ * Each component pair is folded inside its 16-bit lane, then the lanes are packed down
+ * with shifts and masks; an odd tail goes pair by pair.
+ */
+static void lsb4_extract_scalar(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    size_t j = 0;
+
+    for (; j + 4 <= payload_bytes; j += 4, components += 8) {
+        uint64_t nibbles = load_components64(components) & 0x0F0F0F0F0F0F0F0FULL;
+        uint64_t bytes = ((nibbles << 4) | (nibbles >> 8)) & 0x00FF00FF00FF00FFULL;  // Lane k: payload byte k
+        bytes = (bytes | (bytes >> 8)) & 0x0000FFFF0000FFFFULL;
+        bytes = (bytes | (bytes >> 16)) & 0x00000000FFFFFFFFULL;
+        payload[j] = (unsigned char)bytes;
+        payload[j + 1] = (unsigned char)(bytes >> 8);
+        payload[j + 2] = (unsigned char)(bytes >> 16);
+        payload[j + 3] = (unsigned char)(bytes >> 24);
+    }
+
+    for (; j < payload_bytes; j++, components += 2) {
+        payload[j] = (unsigned char)(((components[0] & 0x0F) << 4) | (components[1] & 0x0F));
+    }
+}
+
+/**
+ * @brief n payload bits starting at stream bit `bit`, MSB-first, right-aligned. Bits past
+ * payload_len read as 0; with n <= 4 they span at most two payload bytes.
+ */
+static inline unsigned lsbn_stream_bits(const unsigned char *payload, size_t payload_len, size_t bit, unsigned n) {
+    size_t byte = bit / 8;
+    unsigned window = (unsigned)payload[byte] << 8;
+    if (byte + 1 < payload_len) {
+        window |= payload[byte + 1];
+    }
+    return (window >> (16 - bit % 8 - n)) & ((1u << n) - 1);
+}
+
+/**
+ * @brief Generic LSBn kernels for a compile-time N, so masks and shifts fold to constants.
+ * Embed writes N stream bits per component; extract refills a small accumulator (fewer than
+ * 8 + N pending bits) one component at a time and drains it a byte at a time.
+ */
+#define DEFINE_LSBN_KERNELS(N)                                                                                  \
+static void lsb##N##_embed_generic(unsigned char *carrier, const unsigned char *payload, size_t payload_len,    \
+                                   size_t first_component, size_t count) {                                      \
+    for (size_t i = 0; i < count; i++) {                                                                         \
+        unsigned bits = lsbn_stream_bits(payload, payload_len, (first_component + i) * (N), (N));               \
+        carrier[i] = (unsigned char)((carrier[i] & ~((1u << (N)) - 1)) | bits);                                  \
+    }                                                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static void lsb##N##_extract_generic(const unsigned char *components, size_t first_bit, unsigned char *payload, \
+                                     size_t payload_bytes) {                                                     \
+    unsigned acc = 0;                                                                                            \
+    unsigned acc_bits = 0;                                                                                       \
+    if (first_bit > 0) {                                                                                         \
+        acc = *components++ & (((1u << (N)) - 1) >> first_bit);                                                  \
+        acc_bits = (N) - (unsigned)first_bit;                                                                    \
+    }                                                                                                            \
+    for (size_t j = 0; j < payload_bytes; j++) {                                                                 \
+        while (acc_bits < 8) {                                                                                   \
+            acc = (acc << (N)) | (*components++ & ((1u << (N)) - 1));                                            \
+            acc_bits += (N);                                                                                     \
+        }                                                                                                        \
+        acc_bits -= 8;                                                                                           \
+        payload[j] = (unsigned char)(acc >> acc_bits);                                                           \
+        acc &= (1u << acc_bits) - 1;                                                                             \
+    }                                                                                                            \
+}
+
+// LSB1 and LSB4 have dedicated (vectorized) kernels below
+DEFINE_LSBN_KERNELS(2)
+DEFINE_LSBN_KERNELS(3)
+
+/**
+ * @brief Reference LSBI embed: one table lookup per Blue/Green component.
+ */
+static void lsbi_embed_scalar(unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                              size_t first_data_bit, const LSBITables *tables) {
+    for (size_t i = 0; i < pixel_count; i++, pixels += stride, first_data_bit += 2) {
+        pixels[0] = tables->embed[get_nth_bit(payload, first_data_bit)][pixels[0]];
+        pixels[1] = tables->embed[get_nth_bit(payload, first_data_bit + 1)][pixels[1]];
+    }
+}
+
+/**
+ * @brief Reference LSBI decode: 4 pixels (B,G pairs) -> 1 packed byte.
+ */
+static void lsbi_decode_scalar(const unsigned char *components, size_t pixel_count, unsigned char *packed, const LSBITables *tables) {
+    for (size_t i = 0; i < pixel_count; i += 4, components += 12) {
+        unsigned char byte = 0;
+        for (int p = 0; p < 4; p++) {
+            byte = (unsigned char)((byte << 2) | (tables->decode[components[3 * p]] << 1) | tables->decode[components[3 * p + 1]]);
+        }
+        *packed++ = byte;
+    }
+}
+
+/**
+ * @brief Reference LSBI statistics: one pattern/LSB comparison per Blue/Green component.
+ */
+static void lsbi_count_scalar(const unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                              size_t first_data_bit, uint64_t changed[LSBI_PATTERN_COUNT], uint64_t seen[LSBI_PATTERN_COUNT]) {
+    for (size_t i = 0; i < pixel_count; i++, pixels += stride, first_data_bit += 2) {
+        for (int c = 0; c < 2; c++) {
+            unsigned char pattern = (pixels[c] >> 1) & 0x03;
+            seen[pattern]++;
+            changed[pattern] += (unsigned)((pixels[c] & 1) != get_nth_bit(payload, first_data_bit + c));
+        }
+    }
+}
+
+/**
+ * @brief Reads 32 payload bits starting at an arbitrary bit index (MSB-first), 5 bytes from payload + bit / 8.
+ */
+static inline uint32_t load_bits32(const unsigned char *payload, size_t bit) {
+    const unsigned char *b = payload + bit / 8;
+    uint64_t window = ((uint64_t)b[0] << 32) | ((uint64_t)b[1] << 24) | ((uint64_t)b[2] << 16) | ((uint64_t)b[3] << 8) | b[4];
+    return (uint32_t)(window >> (8 - bit % 8));
+}
+
+// 6 decoded component bits (B0 G0 R0 B1 G1 R1, bit 0 first) -> the 4 data bits B0 G0 B1 G1, MSB first
+static const unsigned char LSBI_COMPACT6[64] = {
+    0x0, 0x8, 0x4, 0xC, 0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x2, 0xA, 0x6, 0xE,
+    0x1, 0x9, 0x5, 0xD, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF, 0x3, 0xB, 0x7, 0xF,
+    0x0, 0x8, 0x4, 0xC, 0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x2, 0xA, 0x6, 0xE,
+    0x1, 0x9, 0x5, 0xD, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF, 0x3, 0xB, 0x7, 0xF,
+};
+
+// -------------------------------------- x86 SIMD --------------------------------------
+
+#ifdef LSB_KERNELS_X86
+
+/**
+ * @brief SSE2: 2 payload bytes -> 16 components per iteration.
+ * Each payload byte is broadcast to 8 lanes, lane b tests bit (7 - b).
+ */
+static void lsb1_embed_aligned_sse2(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m128i bit_select = _mm_set_epi8((char)0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                            0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i keep = _mm_set1_epi8((char)0xFE);
+    size_t j = 0;
+
+    for (; j + 2 <= payload_bytes; j += 2, carrier += 16) {
+        __m128i bytes = _mm_cvtsi32_si128(payload[j] | (payload[j + 1] << 8));
+        bytes = _mm_unpacklo_epi8(bytes, bytes);     // b0 b0 b1 b1
+        bytes = _mm_unpacklo_epi16(bytes, bytes);    // b0 x4, b1 x4
+        bytes = _mm_unpacklo_epi32(bytes, bytes);    // b0 x8, b1 x8
+        __m128i bits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(bytes, bit_select), bit_select), ones);
+
+        __m128i cover = _mm_loadu_si128((const __m128i *)carrier);
+        _mm_storeu_si128((__m128i *)carrier, _mm_or_si128(_mm_and_si128(cover, keep), bits));
+    }
+
+    lsb1_embed_aligned_scalar(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX2: 4 payload bytes -> 32 components per iteration (bytes spread with a shuffle).
+ */
+__attribute__((target("avx2")))
+static void lsb1_embed_aligned_avx2(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit_select = _mm256_set1_epi64x((long long)0x0102040810204080ULL);
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i keep = _mm256_set1_epi8((char)0xFE);
+    size_t j = 0;
+
+    for (; j + 4 <= payload_bytes; j += 4, carrier += 32) {
+        uint32_t word;
+        memcpy(&word, payload + j, sizeof(word));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)word), spread);
+        __m256i bits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit_select), bit_select), ones);
+
+        __m256i cover = _mm256_loadu_si256((const __m256i *)carrier);
+        _mm256_storeu_si256((__m256i *)carrier, _mm256_or_si256(_mm256_and_si256(cover, keep), bits));
+    }
+
+    lsb1_embed_aligned_sse2(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief SSE2: 16 components -> 2 payload bytes per iteration.
+ * Bytes are reversed inside each group of 8 (so the first component lands on bit 7),
+ * shifted so every LSB reaches the sign bit, and collected with movemask.
+ */
+static void lsb1_extract_sse2(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    size_t j = 0;
+
+    for (; j + 2 <= payload_bytes; j += 2, components += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)components);
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));     // Reverse the 16-bit words of each half
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));  // ...and the bytes of each word
+        int mask = _mm_movemask_epi8(_mm_slli_epi16(v, 7));
+        payload[j] = (unsigned char)mask;
+        payload[j + 1] = (unsigned char)(mask >> 8);
+    }
+
+    lsb1_extract_scalar(components, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX2: 32 components -> 4 payload bytes per iteration (group reversal with a shuffle).
+ */
+__attribute__((target("avx2")))
+static void lsb1_extract_avx2(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    size_t j = 0;
+
+    for (; j + 4 <= payload_bytes; j += 4, components += 32) {
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)components), reverse);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(v, 7));
+        payload[j] = (unsigned char)mask;
+        payload[j + 1] = (unsigned char)(mask >> 8);
+        payload[j + 2] = (unsigned char)(mask >> 16);
+        payload[j + 3] = (unsigned char)(mask >> 24);
+    }
+
+    lsb1_extract_sse2(components, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief SSE2: 8 payload bytes -> 16 components per iteration.
+ * High and low nibbles are split into two vectors and interleaved back in order.
+ */
+static void lsb4_embed_aligned_sse2(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    const __m128i keep = _mm_set1_epi8((char)0xF0);
+    size_t j = 0;
+
+    for (; j + 8 <= payload_bytes; j += 8, carrier += 16) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(payload + j));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble);
+        __m128i low = _mm_and_si128(bytes, low_nibble);
+        __m128i nibbles = _mm_unpacklo_epi8(high, low);
+
+        __m128i cover = _mm_loadu_si128((const __m128i *)carrier);
+        _mm_storeu_si128((__m128i *)carrier, _mm_or_si128(_mm_and_si128(cover, keep), nibbles));
+    }
+
+    lsb4_embed_aligned_scalar(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX2: 16 payload bytes -> 32 components per iteration.
+ * Each byte is widened to 16 bits so (high, low) nibbles land in one word, in order.
+ */
+__attribute__((target("avx2")))
+static void lsb4_embed_aligned_avx2(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m256i low_nibble = _mm256_set1_epi16(0x0F);
+    const __m256i keep = _mm256_set1_epi8((char)0xF0);
+    size_t j = 0;
+
+    for (; j + 16 <= payload_bytes; j += 16, carrier += 32) {
+        __m256i words = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(payload + j)));
+        __m256i nibbles = _mm256_or_si256(_mm256_srli_epi16(words, 4),
+                                          _mm256_slli_epi16(_mm256_and_si256(words, low_nibble), 8));
+
+        __m256i cover = _mm256_loadu_si256((const __m256i *)carrier);
+        _mm256_storeu_si256((__m256i *)carrier, _mm256_or_si256(_mm256_and_si256(cover, keep), nibbles));
+    }
+
+    lsb4_embed_aligned_sse2(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief SSE2: 16 components -> 8 payload bytes per iteration.
+ * Each component pair is read as a word and folded into its low byte, then packed.
+ */
+static void lsb4_extract_sse2(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    const __m128i low_nibbles = _mm_set1_epi16(0x0F0F);
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    size_t j = 0;
+
+    for (; j + 8 <= payload_bytes; j += 8, components += 16) {
+        __m128i pairs = _mm_and_si128(_mm_loadu_si128((const __m128i *)components), low_nibbles);
+        __m128i bytes = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(pairs, 4), _mm_srli_epi16(pairs, 8)), low_byte);
+        _mm_storel_epi64((__m128i *)(payload + j), _mm_packus_epi16(bytes, bytes));
+    }
+
+    lsb4_extract_scalar(components, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX2: 32 components -> 16 payload bytes per iteration (lane-fixing permute after the pack).
+ */
+__attribute__((target("avx2")))
+static void lsb4_extract_avx2(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    const __m256i low_nibbles = _mm256_set1_epi16(0x0F0F);
+    const __m256i low_byte = _mm256_set1_epi16(0x00FF);
+    size_t j = 0;
+
+    for (; j + 16 <= payload_bytes; j += 16, components += 32) {
+        __m256i pairs = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)components), low_nibbles);
+        __m256i bytes = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(pairs, 4), _mm256_srli_epi16(pairs, 8)), low_byte);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(bytes, bytes), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)(payload + j), _mm256_castsi256_si128(packed));
+    }
+
+    lsb4_extract_sse2(components, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief SSSE3: 16 pixels (4 payload bytes) per iteration, `stride` vectors of 16 bytes each.
+ * The payload bytes are shuffled onto the B/G lanes and tested against each lane's bit;
+ * the inversion flag comes from a shuffle of the flag table indexed by the pattern.
+ * @return Number of pixels processed (the rest is left to the caller).
+ */
+__attribute__((target("ssse3")))
+static size_t lsbi_embed_ssse3(unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                               size_t payload_len, size_t first_data_bit, const LSBITables *tables) {
+    const int layout = stride == 4 ? 1 : 0;
+    const __m128i flags = _mm_loadu_si128((const __m128i *)tables->flags);
+    const __m128i pattern_mask = _mm_set1_epi8(0x03);
+    size_t i = 0;
+
+    for (; i + 16 <= pixel_count && (first_data_bit + 2 * i) / 8 + 5 <= payload_len; i += 16) {
+        __m128i word = _mm_cvtsi32_si128((int)__builtin_bswap32(load_bits32(payload, first_data_bit + 2 * i)));
+        unsigned char *block = pixels + i * stride;
+
+        for (size_t v = 0; v < stride; v++) {
+            __m128i select = _mm_loadu_si128((const __m128i *)(tables->select[layout] + 16 * v));
+            __m128i bit = _mm_loadu_si128((const __m128i *)(tables->bit[layout] + 16 * v));
+            __m128i lane = _mm_loadu_si128((const __m128i *)(tables->data_lane[layout] + 16 * v));
+            __m128i cover = _mm_loadu_si128((const __m128i *)(block + 16 * v));
+
+            __m128i secret = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(word, select), bit), bit), lane);
+            __m128i flag = _mm_and_si128(_mm_shuffle_epi8(flags, _mm_and_si128(_mm_srli_epi16(cover, 1), pattern_mask)), lane);
+            _mm_storeu_si128((__m128i *)(block + 16 * v), _mm_or_si128(_mm_andnot_si128(lane, cover), _mm_xor_si128(secret, flag)));
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief AVX2: 32 pixels (8 payload bytes, broadcast to both lanes) per iteration.
+ * @return Number of pixels processed (the rest is left to the caller).
+ */
+__attribute__((target("avx2")))
+static size_t lsbi_embed_avx2(unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                              size_t payload_len, size_t first_data_bit, const LSBITables *tables) {
+    const int layout = stride == 4 ? 1 : 0;
+    const __m256i flags = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables->flags));
+    const __m256i pattern_mask = _mm256_set1_epi8(0x03);
+    size_t i = 0;
+
+    for (; i + 32 <= pixel_count && (first_data_bit + 2 * i) / 8 + 9 <= payload_len; i += 32) {
+        size_t bit_idx = first_data_bit + 2 * i;
+        uint64_t bytes = (uint64_t)__builtin_bswap32(load_bits32(payload, bit_idx)) |
+                         ((uint64_t)__builtin_bswap32(load_bits32(payload, bit_idx + 32)) << 32);
+        __m256i word = _mm256_set1_epi64x((long long)bytes);
+        unsigned char *block = pixels + i * stride;
+
+        for (size_t v = 0; v < stride; v++) {
+            __m256i select = _mm256_loadu_si256((const __m256i *)(tables->select[layout] + 32 * v));
+            __m256i bit = _mm256_loadu_si256((const __m256i *)(tables->bit[layout] + 32 * v));
+            __m256i lane = _mm256_loadu_si256((const __m256i *)(tables->data_lane[layout] + 32 * v));
+            __m256i cover = _mm256_loadu_si256((const __m256i *)(block + 32 * v));
+
+            __m256i secret = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(word, select), bit), bit), lane);
+            __m256i flag = _mm256_and_si256(_mm256_shuffle_epi8(flags, _mm256_and_si256(_mm256_srli_epi16(cover, 1), pattern_mask)), lane);
+            _mm256_storeu_si256((__m256i *)(block + 32 * v), _mm256_or_si256(_mm256_andnot_si256(lane, cover), _mm256_xor_si256(secret, flag)));
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief SSSE3 statistics: 16 pixels per iteration. Secret bits are spread as in
+ * lsbi_embed_ssse3; each pattern's lanes, and those of them whose LSB differs, are
+ * counted with a compare, a movemask and a popcount.
+ * @return Number of pixels processed (the rest is left to the caller).
+ */
+__attribute__((target("ssse3")))
+static size_t lsbi_count_ssse3(const unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                               size_t payload_len, size_t first_data_bit, const LSBITables *tables,
+                               uint64_t changed[LSBI_PATTERN_COUNT], uint64_t seen[LSBI_PATTERN_COUNT]) {
+    const int layout = stride == 4 ? 1 : 0;
+    const __m128i pattern_mask = _mm_set1_epi8(0x03);
+    const __m128i ones = _mm_set1_epi8(1);
+    size_t i = 0;
+
+    for (; i + 16 <= pixel_count && (first_data_bit + 2 * i) / 8 + 5 <= payload_len; i += 16) {
+        __m128i word = _mm_cvtsi32_si128((int)__builtin_bswap32(load_bits32(payload, first_data_bit + 2 * i)));
+        const unsigned char *block = pixels + i * stride;
+
+        for (size_t v = 0; v < stride; v++) {
+            __m128i select = _mm_loadu_si128((const __m128i *)(tables->select[layout] + 16 * v));
+            __m128i bit = _mm_loadu_si128((const __m128i *)(tables->bit[layout] + 16 * v));
+            __m128i lane = _mm_loadu_si128((const __m128i *)(tables->data_lane[layout] + 16 * v));
+            __m128i cover = _mm_loadu_si128((const __m128i *)(block + 16 * v));
+
+            __m128i secret = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(word, select), bit), bit), lane);
+            __m128i differs = _mm_cmpeq_epi8(_mm_xor_si128(_mm_and_si128(cover, lane), secret), ones);
+            __m128i in_lane = _mm_cmpeq_epi8(lane, ones);
+            __m128i pattern = _mm_and_si128(_mm_srli_epi16(cover, 1), pattern_mask);
+
+            for (int p = 0; p < LSBI_PATTERN_COUNT; p++) {
+                __m128i match = _mm_and_si128(_mm_cmpeq_epi8(pattern, _mm_set1_epi8((char)p)), in_lane);
+                seen[p] += (uint64_t)__builtin_popcount((unsigned)_mm_movemask_epi8(match));
+                changed[p] += (uint64_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_and_si128(match, differs)));
+            }
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief AVX2 statistics: 32 pixels per iteration (see lsbi_count_ssse3).
+ * @return Number of pixels processed (the rest is left to the caller).
+ */
+__attribute__((target("avx2,popcnt")))
+static size_t lsbi_count_avx2(const unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                              size_t payload_len, size_t first_data_bit, const LSBITables *tables,
+                              uint64_t changed[LSBI_PATTERN_COUNT], uint64_t seen[LSBI_PATTERN_COUNT]) {
+    const int layout = stride == 4 ? 1 : 0;
+    const __m256i pattern_mask = _mm256_set1_epi8(0x03);
+    const __m256i ones = _mm256_set1_epi8(1);
+    size_t i = 0;
+
+    for (; i + 32 <= pixel_count && (first_data_bit + 2 * i) / 8 + 9 <= payload_len; i += 32) {
+        size_t bit_idx = first_data_bit + 2 * i;
+        uint64_t bytes = (uint64_t)__builtin_bswap32(load_bits32(payload, bit_idx)) |
+                         ((uint64_t)__builtin_bswap32(load_bits32(payload, bit_idx + 32)) << 32);
+        __m256i word = _mm256_set1_epi64x((long long)bytes);
+        const unsigned char *block = pixels + i * stride;
+
+        for (size_t v = 0; v < stride; v++) {
+            __m256i select = _mm256_loadu_si256((const __m256i *)(tables->select[layout] + 32 * v));
+            __m256i bit = _mm256_loadu_si256((const __m256i *)(tables->bit[layout] + 32 * v));
+            __m256i lane = _mm256_loadu_si256((const __m256i *)(tables->data_lane[layout] + 32 * v));
+            __m256i cover = _mm256_loadu_si256((const __m256i *)(block + 32 * v));
+
+            __m256i secret = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(word, select), bit), bit), lane);
+            __m256i differs = _mm256_cmpeq_epi8(_mm256_xor_si256(_mm256_and_si256(cover, lane), secret), ones);
+            __m256i in_lane = _mm256_cmpeq_epi8(lane, ones);
+            __m256i pattern = _mm256_and_si256(_mm256_srli_epi16(cover, 1), pattern_mask);
+
+            for (int p = 0; p < LSBI_PATTERN_COUNT; p++) {
+                __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(pattern, _mm256_set1_epi8((char)p)), in_lane);
+                seen[p] += (uint64_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(match));
+                changed[p] += (uint64_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_and_si256(match, differs)));
+            }
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief SSSE3: 16 gathered pixels (48 components) -> 4 packed bytes per iteration.
+ * Every component is decoded (LSB ^ flag), the 48 bits are collected with movemask and
+ * the Red bits are squeezed out 2 pixels at a time through LSBI_COMPACT6.
+ * @return Number of pixels processed (the rest is left to the caller).
+ */
+__attribute__((target("ssse3")))
+static size_t lsbi_decode_ssse3(const unsigned char *components, size_t pixel_count, unsigned char *packed, const LSBITables *tables) {
+    const __m128i flags = _mm_loadu_si128((const __m128i *)tables->flags);
+    const __m128i pattern_mask = _mm_set1_epi8(0x03);
+    size_t i = 0;
+
+    for (; i + 16 <= pixel_count; i += 16, components += 48, packed += 4) {
+        uint64_t bits = 0;
+        for (int v = 0; v < 3; v++) {
+            __m128i stego = _mm_loadu_si128((const __m128i *)(components + 16 * v));
+            __m128i flag = _mm_shuffle_epi8(flags, _mm_and_si128(_mm_srli_epi16(stego, 1), pattern_mask));
+            uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_slli_epi16(_mm_xor_si128(stego, flag), 7));
+            bits |= (uint64_t)mask << (16 * v);
+        }
+        for (int b = 0; b < 4; b++, bits >>= 12) {
+            packed[b] = (unsigned char)((LSBI_COMPACT6[bits & 0x3F] << 4) | LSBI_COMPACT6[(bits >> 6) & 0x3F]);
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief AVX-512BW: 8 payload bytes -> 64 components per iteration.
+ * The bytes are spread as in the AVX2 kernel and tested into a mask register, which
+ * merges an LSB of 1 into the selected components.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb1_embed_aligned_avx512(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m512i spread = _mm512_set_epi64(0x0707070707070707LL, 0x0606060606060606LL, 0x0505050505050505LL,
+                                            0x0404040404040404LL, 0x0303030303030303LL, 0x0202020202020202LL,
+                                            0x0101010101010101LL, 0x0000000000000000LL);
+    const __m512i bit_select = _mm512_set1_epi64((long long)0x0102040810204080ULL);
+    const __m512i ones = _mm512_set1_epi8(1);
+    const __m512i keep = _mm512_set1_epi8((char)0xFE);
+    size_t j = 0;
+
+    for (; j + 8 <= payload_bytes; j += 8, carrier += 64) {
+        uint64_t word;
+        memcpy(&word, payload + j, sizeof(word));
+        __m512i bytes = _mm512_shuffle_epi8(_mm512_set1_epi64((long long)word), spread);
+        __mmask64 bits = _mm512_test_epi8_mask(bytes, bit_select);
+
+        __m512i cover = _mm512_and_si512(_mm512_loadu_si512(carrier), keep);
+        _mm512_storeu_si512(carrier, _mm512_or_si512(cover, _mm512_maskz_mov_epi8(bits, ones)));
+    }
+
+    lsb1_embed_aligned_avx2(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX-512BW: 64 components -> 8 payload bytes per iteration (the LSB test mask is the payload).
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb1_extract_avx512(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    const __m512i reverse = _mm512_set_epi64(0x08090A0B0C0D0E0FLL, 0x0001020304050607LL, 0x08090A0B0C0D0E0FLL,
+                                             0x0001020304050607LL, 0x08090A0B0C0D0E0FLL, 0x0001020304050607LL,
+                                             0x08090A0B0C0D0E0FLL, 0x0001020304050607LL);
+    const __m512i ones = _mm512_set1_epi8(1);
+    size_t j = 0;
+
+    for (; j + 8 <= payload_bytes; j += 8, components += 64) {
+        __m512i v = _mm512_shuffle_epi8(_mm512_loadu_si512(components), reverse);
+        uint64_t mask = (uint64_t)_mm512_test_epi8_mask(v, ones);
+        for (int b = 0; b < 8; b++) {
+            payload[j + b] = (unsigned char)(mask >> (8 * b));
+        }
+    }
+
+    lsb1_extract_avx2(components, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX-512BW: 32 payload bytes -> 64 components per iteration (AVX2 kernel, twice as wide).
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb4_embed_aligned_avx512(unsigned char *carrier, const unsigned char *payload, size_t payload_bytes) {
+    const __m512i low_nibble = _mm512_set1_epi16(0x0F);
+    const __m512i keep = _mm512_set1_epi8((char)0xF0);
+    size_t j = 0;
+
+    for (; j + 32 <= payload_bytes; j += 32, carrier += 64) {
+        __m512i words = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(payload + j)));
+        __m512i nibbles = _mm512_or_si512(_mm512_srli_epi16(words, 4),
+                                          _mm512_slli_epi16(_mm512_and_si512(words, low_nibble), 8));
+
+        __m512i cover = _mm512_loadu_si512(carrier);
+        _mm512_storeu_si512(carrier, _mm512_or_si512(_mm512_and_si512(cover, keep), nibbles));
+    }
+
+    lsb4_embed_aligned_avx2(carrier, payload + j, payload_bytes - j);
+}
+
+/**
+ * @brief AVX-512BW: 64 components -> 32 payload bytes per iteration.
+ * The folded words are narrowed with a truncating move, so no lane fix-up is needed.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb4_extract_avx512(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    const __m512i low_nibbles = _mm512_set1_epi16(0x0F0F);
+    const __m512i low_byte = _mm512_set1_epi16(0x00FF);
+    size_t j = 0;
+
+    for (; j + 32 <= payload_bytes; j += 32, components += 64) {
+        __m512i pairs = _mm512_and_si512(_mm512_loadu_si512(components), low_nibbles);
+        __m512i bytes = _mm512_and_si512(_mm512_or_si512(_mm512_slli_epi16(pairs, 4), _mm512_srli_epi16(pairs, 8)), low_byte);
+        _mm256_storeu_si256((__m256i *)(payload + j), _mm512_cvtepi16_epi8(bytes));
+    }
+
+    lsb4_extract_avx2(components, payload + j, payload_bytes - j);
+}
+
+#endif
+
+// -------------------------------------- Kernel registry --------------------------------------
+
+typedef void (*lsb_embed_aligned_func_t)(unsigned char *, const unsigned char *, size_t);
+typedef void (*lsb_extract_func_t)(const unsigned char *, unsigned char *, size_t);
+typedef size_t (*lsbi_embed_block_func_t)(unsigned char *, size_t, size_t, const unsigned char *, size_t, size_t, const LSBITables *);
+typedef size_t (*lsbi_decode_block_func_t)(const unsigned char *, size_t, unsigned char *, const LSBITables *);
+typedef size_t (*lsbi_count_block_func_t)(const unsigned char *, size_t, size_t, const unsigned char *, size_t, size_t,
+                                          const LSBITables *, uint64_t *, uint64_t *);
+
+/**
+ * @brief The routines bound for one kernel level. LSBI block kernels may be NULL, in which
+ * case the scalar loop handles the whole run.
+ */
+typedef struct {
+    const char *name;
+    lsb_embed_aligned_func_t lsb1_embed;
+    lsb_extract_func_t lsb1_extract;
+    lsb_embed_aligned_func_t lsb4_embed;
+    lsb_extract_func_t lsb4_extract;
+    lsbi_embed_block_func_t lsbi_embed;
+    lsbi_decode_block_func_t lsbi_decode;
+    lsbi_count_block_func_t lsbi_count;
+} LSBKernelSet;
+
+// Indexed by LSBKernelLevel; a level keeps the previous level's routine where it has no wider one
+static const LSBKernelSet KERNEL_SETS[] = {
+    {"scalar", lsb1_embed_aligned_scalar, lsb1_extract_scalar, lsb4_embed_aligned_scalar, lsb4_extract_scalar,
+     NULL, NULL, NULL},
+#ifdef LSB_KERNELS_X86
+    {"sse", lsb1_embed_aligned_sse2, lsb1_extract_sse2, lsb4_embed_aligned_sse2, lsb4_extract_sse2,
+     lsbi_embed_ssse3, lsbi_decode_ssse3, lsbi_count_ssse3},
+    {"avx2", lsb1_embed_aligned_avx2, lsb1_extract_avx2, lsb4_embed_aligned_avx2, lsb4_extract_avx2,
+     lsbi_embed_avx2, lsbi_decode_ssse3, lsbi_count_avx2},
+    {"avx512", lsb1_embed_aligned_avx512, lsb1_extract_avx512, lsb4_embed_aligned_avx512, lsb4_extract_avx512,
+     lsbi_embed_avx2, lsbi_decode_ssse3, lsbi_count_avx2},
+#endif
+};
+
+static const LSBKernelSet *active_kernels = NULL;
+
+LSBKernelLevel lsb_kernels_detect(void) {
+    static int detected = -1;
+
+    if (detected < 0) {
+        detected = LSB_KERNEL_SCALAR;
+#ifdef LSB_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            detected = LSB_KERNEL_AVX512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            detected = LSB_KERNEL_AVX2;
+        } else if (__builtin_cpu_supports("ssse3")) {
+            detected = LSB_KERNEL_SSE;
+        }
+#endif
+    }
+    return (LSBKernelLevel)detected;
+}
+
+int lsb_kernels_select(const char *name) {
+    LSBKernelLevel supported = lsb_kernels_detect();
+
+    if (!name || strcmp(name, "auto") == 0) {
+        active_kernels = &KERNEL_SETS[supported];
+        return 0;
+    }
+
+    for (size_t level = 0; level < sizeof(KERNEL_SETS) / sizeof(KERNEL_SETS[0]); level++) {
+        if (strcmp(name, KERNEL_SETS[level].name) == 0) {
+            if (level > (size_t)supported) {
+                break;
+            }
+            active_kernels = &KERNEL_SETS[level];
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Error: Kernel '%s' is not supported on this CPU (best available: %s).\n", name, KERNEL_SETS[supported].name);
+    return -1;
+}
+
+/**
+ * @brief The bound kernel set; the best supported one unless lsb_kernels_select chose another.
+ */
+static const LSBKernelSet *lsb_kernels(void) {
+    if (!active_kernels) {
+        lsb_kernels_select(NULL);
+    }
+    return active_kernels;
+}
+
+const char *lsb_kernels_name(void) {
+    return lsb_kernels()->name;
+}
+
+void lsb1_embed_bytes(unsigned char *carrier, const unsigned char *payload, size_t first_bit, size_t count) {
+    // Head: bit by bit up to the next payload byte boundary
+    size_t head = (8 - first_bit % 8) % 8;
+    if (head > count) head = count;
+    lsb1_embed_scalar(carrier, payload, first_bit, head);
+    carrier += head;
+    first_bit += head;
+    count -= head;
+
+    // Body: whole payload bytes through the vector kernel
+    size_t payload_bytes = count / 8;
+    if (payload_bytes > 0) {
+        lsb_kernels()->lsb1_embed(carrier, payload + first_bit / 8, payload_bytes);
+        carrier += payload_bytes * 8;
+        first_bit += payload_bytes * 8;
+        count -= payload_bytes * 8;
+    }
+
+    // Tail: remaining bits of a partial payload byte
+    lsb1_embed_scalar(carrier, payload, first_bit, count);
+}
+
+void lsb1_extract_bytes(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    lsb_kernels()->lsb1_extract(components, payload, payload_bytes);
+}
+
+void lsb4_embed_bytes(unsigned char *carrier, const unsigned char *payload, size_t first_nibble, size_t count) {
+    // Head: a low nibble left over from the previous span
+    size_t head = (first_nibble % 2 != 0 && count > 0) ? 1 : 0;
+    lsb4_embed_scalar(carrier, payload, first_nibble, head);
+    carrier += head;
+    first_nibble += head;
+    count -= head;
+
+    // Body: whole payload bytes (two components each) through the vector kernel
+    size_t payload_bytes = count / 2;
+    if (payload_bytes > 0) {
+        lsb_kernels()->lsb4_embed(carrier, payload + first_nibble / 2, payload_bytes);
+        carrier += payload_bytes * 2;
+        first_nibble += payload_bytes * 2;
+        count -= payload_bytes * 2;
+    }
+
+    // Tail: a lone high nibble
+    lsb4_embed_scalar(carrier, payload, first_nibble, count);
+}
+
+void lsb4_extract_bytes(const unsigned char *components, unsigned char *payload, size_t payload_bytes) {
+    lsb_kernels()->lsb4_extract(components, payload, payload_bytes);
+}
+
+void lsbn_embed_bytes(int bits, unsigned char *carrier, const unsigned char *payload, size_t payload_len,
+                      size_t first_component, size_t count) {
+    switch (bits) {
+        case 1: lsb1_embed_bytes(carrier, payload, first_component, count); break;
+        case 2: lsb2_embed_generic(carrier, payload, payload_len, first_component, count); break;
+        case 3: lsb3_embed_generic(carrier, payload, payload_len, first_component, count); break;
+        case 4: lsb4_embed_bytes(carrier, payload, first_component, count); break;
+        default: break;
+    }
+}
+
+void lsbn_extract_bytes(int bits, const unsigned char *components, size_t first_bit, unsigned char *payload, size_t payload_bytes) {
+    switch (bits) {
+        case 1: lsb1_extract_bytes(components, payload, payload_bytes); break;
+        case 2: lsb2_extract_generic(components, first_bit, payload, payload_bytes); break;
+        case 3: lsb3_extract_generic(components, first_bit, payload, payload_bytes); break;
+        case 4: lsb4_extract_bytes(components, payload, payload_bytes); break;
+        default: break;
+    }
+}
+
+void lsbi_build_tables(LSBITables *tables, unsigned char inversion_map) {
+    memset(tables, 0, sizeof(*tables));
+
+    for (int pattern = 0; pattern < 4; pattern++) {
+        tables->flags[pattern] = (inversion_map >> pattern) & 1;
+    }
+
+    // The pattern (bits 1-2) is not touched by the LSB write, so the flag is that of the cover
+    for (int value = 0; value < 256; value++) {
+        unsigned char flag = tables->flags[(value >> 1) & 0x03];
+        tables->embed[0][value] = (unsigned char)((value & 0xFE) | (0 ^ flag));
+        tables->embed[1][value] = (unsigned char)((value & 0xFE) | (1 ^ flag));
+        tables->decode[value] = (unsigned char)((value & 1) ^ flag);
+    }
+
+    // Block layouts: pixel p of the block carries data bits 2p (Blue) and 2p + 1 (Green)
+    for (int layout = 0; layout < 2; layout++) {
+        size_t stride = layout == 0 ? 3 : 4;
+        for (size_t i = 0; i < LSBI_BLOCK_PIXELS * stride; i++) {
+            size_t channel = i % stride;
+            size_t data_bit = 2 * (i / stride) + channel;
+            if (channel < 2) {
+                tables->select[layout][i] = (unsigned char)(data_bit / 8);
+                tables->bit[layout][i] = (unsigned char)(0x80 >> (data_bit % 8));
+                tables->data_lane[layout][i] = 1;
+            } else {
+                tables->select[layout][i] = 0x80;
+            }
+        }
+    }
+}
+
+void lsbi_embed_span(unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                     size_t payload_len, size_t first_data_bit, const LSBITables *tables) {
+    lsbi_embed_block_func_t kernel = lsb_kernels()->lsbi_embed;
+    size_t done = kernel ? kernel(pixels, pixel_count, stride, payload, payload_len, first_data_bit, tables) : 0;
+
+    lsbi_embed_scalar(pixels + done * stride, pixel_count - done, stride, payload, first_data_bit + 2 * done, tables);
+}
+
+void lsbi_decode_pixels(const unsigned char *components, size_t pixel_count, unsigned char *packed, const LSBITables *tables) {
+    lsbi_decode_block_func_t kernel = lsb_kernels()->lsbi_decode;
+    size_t done = kernel ? kernel(components, pixel_count, packed, tables) : 0;
+
+    lsbi_decode_scalar(components + done * 3, pixel_count - done, packed + done / 4, tables);
+}
+
+void lsbi_count_patterns(const unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                         size_t payload_len, size_t first_data_bit, const LSBITables *tables,
+                         uint64_t changed[LSBI_PATTERN_COUNT], uint64_t seen[LSBI_PATTERN_COUNT]) {
+    lsbi_count_block_func_t kernel = lsb_kernels()->lsbi_count;
+    size_t done = kernel ? kernel(pixels, pixel_count, stride, payload, payload_len, first_data_bit, tables, changed, seen) : 0;
+
+    lsbi_count_scalar(pixels + done * stride, pixel_count - done, stride, payload, first_data_bit + 2 * done, changed, seen);
+}
@@ -0,0 +1,205 @@
+#ifndef LSB_KERNELS_H
+#define LSB_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LSBI_BLOCK_PIXELS 32    // Pixels per vector block of the LSBI embed (AVX2; SSSE3 uses the first 16)
+#define LSBI_PATTERN_COUNT 4    // Patterns 00, 01, 10, 11 (bits 1-2 of a component)
+
+/**
+ * @brief Kernel levels of the registry, narrowest first. SSE needs SSSE3, AVX512 needs AVX-512F/BW;
+ * routines without a wider variant keep the one of the level below.
+ */
+typedef enum {
+    LSB_KERNEL_SCALAR = 0,
+    LSB_KERNEL_SSE,
+    LSB_KERNEL_AVX2,
+    LSB_KERNEL_AVX512
+} LSBKernelLevel;
+
+/**
+ * @brief Lookup tables for one LSBI inversion map, built once per job by lsbi_build_tables.
+ * The select/bit/data_lane rows describe a block of LSBI_BLOCK_PIXELS pixels for each
+ * layout ([0] = 24-bit BGR, [1] = 32-bit BGRA): which byte of the block's 64 payload bits
+ * feeds each carrier byte, which bit of it, and whether the byte is Blue/Green at all.
+ */
+typedef struct {
+    unsigned char embed[2][256];                        // Stego byte for (secret bit, cover byte)
+    unsigned char decode[256];                          // Secret bit carried by a stego byte
+    unsigned char flags[16];                            // Inversion flag per pattern (entries 0-3), shuffle table
+    unsigned char select[2][LSBI_BLOCK_PIXELS * 4];     // Payload byte of the block (0x80 = none)
+    unsigned char bit[2][LSBI_BLOCK_PIXELS * 4];        // Mask of the payload bit inside that byte
+    unsigned char data_lane[2][LSBI_BLOCK_PIXELS * 4];  // 1 on Blue/Green, 0 on Red/alpha
+} LSBITables;
+
+/**
+ * @brief Detects the widest kernel level this CPU (and build) supports. Runs cpuid once.
+ * @return The detected level (LSB_KERNEL_SCALAR outside x86).
+ */
+LSBKernelLevel lsb_kernels_detect(void);
+
+/**
+ * @brief Binds every embed/extract routine below to the implementations of one level.
+ * Without a call, the detected level is bound on first use. Call it before starting
+ * worker threads.
+ * @param name "scalar", "sse", "avx2", "avx512", or NULL / "auto" for the detected level.
+ * @return 0 on success, -1 if the level is unknown or not supported by the CPU.
+ */
+int lsb_kernels_select(const char *name);
+
+/**
+ * @brief Name of the bound kernel level.
+ */
+const char *lsb_kernels_name(void);
+
+/**
+ * @brief LSB1 embed over a flat run of carrier bytes (color components).
+ *
+ * Component i receives payload bit (first_bit + i), MSB-first within each payload
+ * byte (the LSBn stream layout with n = 1). In a 24-bit row B,G,R are just
+ * consecutive bytes, so a whole span can be passed at once.
+ * Whole payload bytes are expanded to 16/32/64 component LSBs per instruction (SSE2/AVX2/
+ * AVX-512BW on x86, bound by the kernel registry); the unaligned head and the tail are
+ * done bit by bit.
+ *
+ * @param carrier First component to modify.
+ * @param payload Payload buffer (Size|Data|Ext).
+ * @param first_bit Index of the payload bit that goes into carrier[0].
+ * @param count Number of components (= bits) to embed.
+ */
+void lsb1_embed_bytes(unsigned char *carrier, const unsigned char *payload, size_t first_bit, size_t count);
+
+/**
+ * @brief LSB1 extract: packs the LSBs of 8 consecutive components into each payload byte.
+ *
+ * Component 8j + b supplies bit (7 - b) of payload[j] (MSB-first, the inverse of
+ * lsb1_embed_bytes). 16/32/64 LSBs are collected per instruction with a byte shift and
+ * movemask, or a test mask on AVX-512BW (bound by the kernel registry).
+ *
+ * @param components Gathered components (B,G,R order, padding and alpha already removed).
+ * @param payload Output buffer.
+ * @param payload_bytes Number of bytes to produce (reads 8 * payload_bytes components).
+ */
+void lsb1_extract_bytes(const unsigned char *components, unsigned char *payload, size_t payload_bytes);
+
+/**
+ * @brief LSB4 embed over a flat run of carrier bytes (color components).
+ *
+ * Component i receives payload nibble (first_nibble + i) in its low nibble, high nibble
+ * of each payload byte first (the LSBn stream layout with n = 4). Whole payload
+ * bytes are split into nibble pairs and merged 16/32/64 components per instruction
+ * (SSE2/AVX2/AVX-512BW on x86, bound by the kernel registry).
+ *
+ * @param carrier First component to modify.
+ * @param payload Payload buffer (Size|Data|Ext).
+ * @param first_nibble Index of the payload nibble that goes into carrier[0].
+ * @param count Number of components (= nibbles) to embed.
+ */
+void lsb4_embed_bytes(unsigned char *carrier, const unsigned char *payload, size_t first_nibble, size_t count);
+
+/**
+ * @brief LSB4 extract: joins the low nibbles of each pair of consecutive components.
+ *
+ * payload[j] = (components[2j] & 0x0F) << 4 | (components[2j + 1] & 0x0F), the inverse
+ * of lsb4_embed_bytes, 16/32/64 components per instruction (SSE2/AVX2/AVX-512BW on x86).
+ *
+ * @param components Gathered components (B,G,R order, padding and alpha already removed).
+ * @param payload Output buffer.
+ * @param payload_bytes Number of bytes to produce (reads 2 * payload_bytes components).
+ */
+void lsb4_extract_bytes(const unsigned char *components, unsigned char *payload, size_t payload_bytes);
+
+/**
+ * @brief LSBn embed (n = 1..4) over a flat run of carrier bytes (color components).
+ *
+ * The payload is one MSB-first bit stream: component i takes stream bits
+ * n * (first_component + i) .. + n - 1 in its n low bits, the first one highest. Bits past
+ * payload_len read as 0 (with n = 3 the last component may be only partly payload).
+ * n = 1 and n = 4 go through lsb1_embed_bytes / lsb4_embed_bytes, n = 2 and n = 3 through
+ * generic kernels specialized per n at compile time.
+ *
+ * @param bits Bits per component (n).
+ * @param carrier First component to modify.
+ * @param payload Payload buffer (Size|Data|Ext).
+ * @param payload_len Length of the payload buffer in bytes.
+ * @param first_component Index (in the stream) of the component at carrier[0].
+ * @param count Number of components to embed.
+ */
+void lsbn_embed_bytes(int bits, unsigned char *carrier, const unsigned char *payload, size_t payload_len,
+                      size_t first_component, size_t count);
+
+/**
+ * @brief LSBn extract, the inverse of lsbn_embed_bytes: drops the first `first_bit` stream
+ * bits held by components[0], then packs the n low bits of each component MSB-first.
+ *
+ * @param bits Bits per component (n).
+ * @param components Gathered components (B,G,R order, padding and alpha already removed).
+ * @param first_bit Stream bits of components[0] to skip (< n; always 0 unless n = 3).
+ * @param payload Output buffer.
+ * @param payload_bytes Number of bytes to produce (reads ceil((first_bit + 8 * payload_bytes) / n) components).
+ */
+void lsbn_extract_bytes(int bits, const unsigned char *components, size_t first_bit, unsigned char *payload, size_t payload_bytes);
+
+/**
+ * @brief Builds the LSBI lookup tables for an inversion map.
+ * @param tables Tables to fill.
+ * @param inversion_map 4-bit map (bit i set = invert pattern i).
+ */
+void lsbi_build_tables(LSBITables *tables, unsigned char inversion_map);
+
+/**
+ * @brief LSBI embed over pixel_count whole pixels: Blue and Green of pixel i take payload
+ * bits first_data_bit + 2i and + 2i + 1, Red and alpha are left untouched.
+ *
+ * Each component becomes tables->embed[bit][cover], the same value the LSBI pixel
+ * callback produces. Long runs are done 16/32 pixels at a time with a byte shuffle that
+ * spreads the payload bits over the B/G lanes and looks up the inversion flag of each
+ * pattern (SSSE3/AVX2 on x86, bound by the kernel registry).
+ *
+ * @param pixels First pixel of the run.
+ * @param pixel_count Number of pixels (2 * pixel_count payload bits must be available).
+ * @param stride Bytes per pixel (3 = BGR, 4 = BGRA).
+ * @param payload Payload buffer (Size|Data|Ext).
+ * @param payload_len Length of the payload buffer in bytes (bounds the vector loads).
+ * @param first_data_bit Index of the payload bit that goes into the first Blue.
+ * @param tables Tables built for the inversion map in use.
+ */
+void lsbi_embed_span(unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                     size_t payload_len, size_t first_data_bit, const LSBITables *tables);
+
+/**
+ * @brief LSBI statistics: for each pattern, how many Blue/Green components would change their LSB.
+ *
+ * Blue and Green of pixel i are compared against payload bits first_data_bit + 2i and
+ * + 2i + 1; seen[p] counts the components with pattern p and changed[p] those whose LSB
+ * differs from their bit. Both arrays are accumulated into, not cleared. Long runs are
+ * counted 16/32 pixels at a time with byte compares and a popcount of the movemask
+ * (SSSE3/AVX2 on x86).
+ *
+ * @param pixels First pixel of the run (read only).
+ * @param pixel_count Number of pixels (2 * pixel_count payload bits must be available).
+ * @param stride Bytes per pixel (3 = BGR, 4 = BGRA).
+ * @param payload Payload buffer (Size|Data|Ext).
+ * @param payload_len Length of the payload buffer in bytes (bounds the vector loads).
+ * @param first_data_bit Index of the payload bit compared with the first Blue.
+ * @param tables Any LSBI tables (only the block layouts are used).
+ * @param changed Per-pattern count of components whose LSB would change.
+ * @param seen Per-pattern count of components.
+ */
+void lsbi_count_patterns(const unsigned char *pixels, size_t pixel_count, size_t stride, const unsigned char *payload,
+                         size_t payload_len, size_t first_data_bit, const LSBITables *tables,
+                         uint64_t changed[LSBI_PATTERN_COUNT], uint64_t seen[LSBI_PATTERN_COUNT]);
+
+/**
+ * @brief LSBI decode of gathered pixels: 2 bits per pixel (Blue then Green), packed MSB-first.
+ * Red is skipped; every 4 pixels produce one byte of `packed`. 16 pixels are decoded per
+ * step with a shuffle lookup of the inversion flags and movemask (SSSE3 on x86).
+ * @param components Gathered components, 3 per pixel (B,G,R).
+ * @param pixel_count Number of pixels, a multiple of 4.
+ * @param packed Output buffer (pixel_count / 4 bytes).
+ * @param tables Tables built for the inversion map in use.
+ */
+void lsbi_decode_pixels(const unsigned char *components, size_t pixel_count, unsigned char *packed, const LSBITables *tables);
+
+#endif // LSB_KERNELS_H
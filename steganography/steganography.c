@@ -1,159 +1,373 @@
 #include "steganography.h"
 #include "../error.h"
+#include "../bmp_io.h"
 #include "embed_utils.h"
 #include "extract_utils.h"
+#include "lsb_kernels.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define PARALLEL_EXTRACT_MIN_BYTES (64 * 1024)  // Smallest data range worth its own extraction thread
+#define EXTRACT_STREAM_BYTES (4 * 1024 * 1024)  // Payload bytes decoded per chunk handed to the sink
+#define EMBED_WINDOW_PIXELS 4096                // Pixels embedded per payload window
+#define EMBED_WINDOW_BYTES (EMBED_WINDOW_PIXELS * LSB4_BITS_PER_PIXEL / 8 + 8)  // Largest window (LSB4), plus alignment
 
 
 // -------------------------------------- STATIC AUXILIARY FUNCTIONS --------------------------------------
 
 
 /**
- * @brief Handles the generic extraction flow (Header -> Data -> Extension) using a specific byte extraction function.
- * @param image Pointer to the BMPImage.
- * @param data_size_out Pointer to store the extracted data size.
- * @param ext_len_out Pointer to store the extension length.
- * @param get_next_byte_func The algorithm-specific function to call for the next byte.
- * @param ctx Pointer to the context structure containing state (bit_count, pixel, map).
- * @return Pointer to the extracted payload buffer, or NULL on error.
+ * @brief Number of pixels (storage order) touched when hiding `bits` bits at `bits_per_pixel` per pixel.
  */
-static unsigned char *extract_payload_generic(BMPImage *image, size_t *data_size_out, size_t *ext_len_out, get_next_byte_func_t get_next_byte_func, ExtractionContext *ctx, char encrypted) {
-    // --- Step 1: Extract Header (4 bytes) ---
-    unsigned char size_buffer[4] = {0};
-    for (int i = 0; i < 4; i++) {
-        int extracted_byte = get_next_byte_func(image, ctx);
-        if (extracted_byte == -1) return NULL;
-        size_buffer[i] = (unsigned char)extracted_byte;
+static size_t pixels_for_bits(size_t bits, int bits_per_pixel) {
+    return (bits + (size_t)bits_per_pixel - 1) / (size_t)bits_per_pixel;
+}
+
+/**
+ * @brief Stream bytes [first_byte, end_byte) of the payload (clipped to its end), for a run of
+ * pixels, read into scratch (EMBED_WINDOW_BYTES). *window_len is how many bytes it holds.
+ */
+static const unsigned char *payload_window(PayloadSource *payload, size_t first_byte, size_t end_byte,
+                                           unsigned char *scratch, size_t *window_len) {
+    if (end_byte > payload->len) {
+        end_byte = payload->len;
     }
+    *window_len = end_byte - first_byte;
+    read_payload(payload, first_byte, scratch, *window_len);
+    return scratch;
+}
+
+/**
+ * @brief Points the embed window of ctx at stream bytes [first_byte, end_byte) (see payload_window).
+ */
+static void load_embed_window(StegoContext *ctx, size_t first_byte, size_t end_byte, unsigned char *scratch) {
+    ctx->window = payload_window(ctx->payload, first_byte, end_byte, scratch, &ctx->window_len);
+    ctx->window_first_byte = first_byte;
+}
 
-    uint32_t data_size = read_size_header(size_buffer);
+typedef struct {
+    BMPImage *image;
+    ExtractionContext ctx;      // Private copy, positioned at the first byte of the range
+    get_next_block_func_t get_next_block_func;
+    unsigned char *out;
+    size_t len;
+    int result;
+} ExtractWorker;
+
+static void *extract_worker_main(void *arg) {
+    ExtractWorker *worker = (ExtractWorker *)arg;
+    worker->result = worker->get_next_block_func(worker->image, &worker->ctx, worker->out, worker->len);
+    return NULL;
+}
 
-    // Sanity check
-    long max_capacity_bytes = get_pixel_count(image) * 3 / 8;
-    if (data_size == 0 || data_size > max_capacity_bytes) {
-        fprintf(stderr, "Error: Invalid or impossibly large data size extracted: %u\n", data_size);
-        return NULL;
+/**
+ * @brief Reads the carrier rows holding the next len payload bytes after ctx (streamed
+ * carriers, see load_bmp_pixels), so rows are only read once the decoder reaches them.
+ * Runs on the calling thread: load_bmp_pixels may move the rows, workers only read them.
+ * @return 0 on success, -1 on error (printed).
+ */
+static int load_payload_rows(BMPImage *image, const ExtractionContext *ctx, skip_payload_func_t skip_func, size_t len) {
+    const uint64_t n = (uint64_t)ctx->bits_per_component;
+    uint64_t end_component = (skip_func(ctx->bit_count, len) + n - 1) / n;
+    uint64_t end_pixel = end_component / 3 + (end_component % 3 != 0);
+    if (end_pixel > SIZE_MAX) {
+        return -1;
     }
+    return load_bmp_pixels(image, (size_t)end_pixel);
+}
 
-    // --- Step 2: Allocate Buffer ---
-    size_t total_buffer_allocation = (size_t)data_size + MAX_EXT_LEN;
-    unsigned char *data_buffer = malloc(total_buffer_allocation);
-    if (!data_buffer) return NULL;
-    memset(data_buffer, 0, total_buffer_allocation);
+/**
+ * @brief Drops the carrier rows behind ctx (streamed carriers, see release_bmp_pixels).
+ * @return 0 on success, -1 on error (printed).
+ */
+static int release_payload_rows(BMPImage *image, const ExtractionContext *ctx) {
+    uint64_t pixel = ctx->bit_count / (uint64_t)ctx->bits_per_component / 3;
+    return release_bmp_pixels(image, pixel > SIZE_MAX ? SIZE_MAX : (size_t)pixel);
+}
 
-    // --- Step 3: Extract Data ---
-    size_t current_byte_idx = 0;
-    while (current_byte_idx < data_size) {
-        int extracted_byte = get_next_byte_func(image, ctx);
-        if (extracted_byte == -1) {
-            fprintf(stderr, "Error: Unexpected end of file during data extraction.\n");
-            free(data_buffer);
-            return NULL;
+/**
+ * @brief Extracts `len` payload bytes with get_next_block_func, split among image->threads workers.
+ * Once the header is decoded, the components holding every later byte are known
+ * (skip_func), so each worker starts its own copy of ctx at its range and writes straight
+ * into out. ctx is left where a single call would have left it.
+ * @return 0 on success, -1 on read error.
+ */
+static int extract_blocks_parallel(BMPImage *image, ExtractionContext *ctx, get_next_block_func_t get_next_block_func,
+                                   skip_payload_func_t skip_func, unsigned char *out, size_t len) {
+    if (load_payload_rows(image, ctx, skip_func, len) != 0) {
+        return -1;
+    }
+
+    size_t workers = image->threads;
+    if (workers > len / PARALLEL_EXTRACT_MIN_BYTES) {
+        workers = len / PARALLEL_EXTRACT_MIN_BYTES;
+    }
+    if (workers <= 1) {
+        return get_next_block_func(image, ctx, out, len);
+    }
+
+    ExtractWorker *pool = calloc(workers, sizeof(*pool));
+    pthread_t *tids = calloc(workers, sizeof(*tids));
+    int *started = calloc(workers, sizeof(*started));
+    if (!pool || !tids || !started) {
+        free(pool);
+        free(tids);
+        free(started);
+        return get_next_block_func(image, ctx, out, len);
+    }
+
+    size_t offset = 0;
+    for (size_t w = 0; w < workers; w++) {
+        pool[w].image = image;
+        pool[w].ctx = *ctx;
+        pool[w].ctx.bit_count = skip_func(ctx->bit_count, offset);
+        pool[w].get_next_block_func = get_next_block_func;
+        pool[w].out = out + offset;
+        pool[w].len = len / workers + (w < len % workers ? 1 : 0);
+        offset += pool[w].len;
+    }
+
+    // The calling thread takes the first range; a worker that cannot be started runs here too
+    for (size_t w = 1; w < workers; w++) {
+        started[w] = pthread_create(&tids[w], NULL, extract_worker_main, &pool[w]) == 0;
+    }
+    extract_worker_main(&pool[0]);
+    int result = pool[0].result;
+    for (size_t w = 1; w < workers; w++) {
+        if (started[w]) {
+            pthread_join(tids[w], NULL);
+        } else {
+            extract_worker_main(&pool[w]);
         }
-        data_buffer[current_byte_idx] = (unsigned char)extracted_byte;
-        current_byte_idx++;
-    }
-
-    // --- Step 4: Handle encrypted vs non-encrypted ---
-    if (encrypted != TRUE) {
-        // Non-encrypted: Extract extension after data
-        // --- Step 5: Extract Extension ---
-        size_t ext_start_byte = data_size;
-        size_t ext_bytes_read = 0;
-
-        while (ext_bytes_read < MAX_EXT_LEN) {
-            int extracted_byte = get_next_byte_func(image, ctx);
-            if (extracted_byte == -1) {
-                fprintf(stderr, "Error: Unexpected end of file before finding extension terminator.\n");
-                free(data_buffer);
-                return NULL;
-            }
+        if (pool[w].result != 0) {
+            result = -1;
+        }
+    }
 
-            data_buffer[ext_start_byte + ext_bytes_read] = (unsigned char)extracted_byte;
+    *ctx = pool[workers - 1].ctx;
+    free(pool);
+    free(tids);
+    free(started);
+    return result;
+}
 
-            if (data_buffer[ext_start_byte + ext_bytes_read] == '\0') {
-                break;
+/**
+ * @brief Decodes the next len bytes of reader into out (see extract_blocks_parallel).
+ * @return 0 on success, -1 on read error.
+ */
+static int read_payload_bytes(BMPImage *image, PayloadReader *reader, unsigned char *out, size_t len) {
+    return extract_blocks_parallel(image, &reader->ctx, reader->read, reader->skip, out, len);
+}
+
+/**
+ * @brief Decodes `len` payload bytes from the reader's position and hands them to sink in
+ * chunks of EXTRACT_STREAM_BYTES (each one split among the worker threads), so a single
+ * chunk is in memory whatever the payload size. The rows of a streamed carrier are dropped
+ * as the reader passes them: it cannot be moved back afterwards.
+ * @return 0 on success, -1 on read or sink error (printed).
+ */
+static int stream_payload_bytes(BMPImage *image, PayloadReader *reader, uint64_t len, payload_sink_func_t sink, void *sink_ctx) {
+    size_t chunk_len = len < EXTRACT_STREAM_BYTES ? (size_t)len : EXTRACT_STREAM_BYTES;
+    unsigned char *chunk = malloc(chunk_len > 0 ? chunk_len : 1);
+    int result = 0;
+
+    if (!chunk) {
+        fprintf(stderr, "Error: Failed to allocate memory for the extraction buffer.\n");
+        return -1;
+    }
+    while (len > 0 && result == 0) {
+        size_t n = len < chunk_len ? (size_t)len : chunk_len;
+        if (read_payload_bytes(image, reader, chunk, n) != 0) {
+            fprintf(stderr, "Error: Unexpected end of file during data extraction.\n");
+            result = -1;
+        } else {
+            result = sink(sink_ctx, chunk, n);
+            len -= n;
+            if (result == 0) {
+                result = release_payload_rows(image, &reader->ctx);
             }
+        }
+    }
+
+    free(chunk);
+    return result;
+}
+
+/**
+ * @brief Handles the generic extraction flow (Header -> Data -> Extension) over an algorithm's reader.
+ * The data goes to sink as it is decoded; the extension that follows it is read last.
+ * @param image Pointer to the BMPImage.
+ * @param reader Reader positioned at the size header.
+ * @param encrypted TRUE if the payload is encrypted (no extension after the data).
+ * @param bits_per_pixel Bits the algorithm hides per pixel, used to bound the extracted size.
+ * @param sink Receives the data section, in order.
+ * @param sink_ctx Passed to sink.
+ * @param info Set to the size header and the extension.
+ * @return EXIT_SUCCESS or EXIT_FAILURE (printed).
+ */
+static int extract_payload_generic(BMPImage *image, PayloadReader *reader, char encrypted, int bits_per_pixel,
+                                   payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    unsigned char size_buffer[4] = {0};
+
+    memset(info, 0, sizeof(*info));
+
+    // --- Step 1: Extract Header (4 bytes) ---
+    if (read_payload_bytes(image, reader, size_buffer, sizeof(size_buffer)) != 0) {
+        fprintf(stderr, "Error: Failed to read pixel data during extraction.\n");
+        return EXIT_FAILURE;
+    }
+    info->data_size = read_size_header(size_buffer);
+
+    // Sanity check
+    uint64_t max_capacity_bytes = get_capacity_bits(image, bits_per_pixel) / 8;
+    if (info->data_size == 0 || info->data_size > max_capacity_bytes) {
+        fprintf(stderr, "Error: Invalid or impossibly large data size extracted: %u\n", info->data_size);
+        return EXIT_FAILURE;
+    }
+
+    // --- Step 2: Stream the data to the sink, chunk by chunk ---
+    if (stream_payload_bytes(image, reader, info->data_size, sink, sink_ctx) != 0) {
+        return EXIT_FAILURE;
+    }
 
-            ext_bytes_read++;
+    // --- Step 3: Encrypted: the extension is inside the ciphertext ---
+    if (encrypted) {
+        return EXIT_SUCCESS;
+    }
+
+    // --- Step 4: Extract Extension (Sequentially until '\0') ---
+    size_t ext_bytes_read = 0;
+    while (ext_bytes_read < MAX_EXT_LEN) {
+        unsigned char extracted_byte;
+        if (read_payload_bytes(image, reader, &extracted_byte, 1) != 0) {
+            fprintf(stderr, "Error: Unexpected end of file before finding extension terminator.\n");
+            return EXIT_FAILURE;
         }
 
-        if (ext_bytes_read >= MAX_EXT_LEN) {
-            fprintf(stderr, "Error: Extension length exceeded maximum allowed size (%d bytes) without terminator.\n", MAX_EXT_LEN);
-            free(data_buffer);
-            return NULL;
+        info->extension[ext_bytes_read] = (char)extracted_byte;
+        if (extracted_byte == '\0') {
+            break;
         }
+        ext_bytes_read++;
+    }
+
+    if (ext_bytes_read >= MAX_EXT_LEN) {
+        fprintf(stderr, "Error: Extension length exceeded maximum allowed size (%d bytes) without terminator.\n", MAX_EXT_LEN);
+        return EXIT_FAILURE;
+    }
 
-        if (ext_bytes_read == 0 || data_buffer[ext_start_byte] != '.') {
-            fprintf(stderr, "Error: Extracted extension does not start with '.' (Invalid format).\n");
-            free(data_buffer);
-            return NULL;
+    if (ext_bytes_read == 0 || info->extension[0] != '.') {
+        fprintf(stderr, "Error: Extracted extension does not start with '.' (Invalid format).\n");
+        return EXIT_FAILURE;
+    }
+
+    info->extension_len = ext_bytes_read + 1;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief State of the LSBI statistics pass (PHASE 1) while it walks the carrier rows.
+ */
+typedef struct {
+    PayloadSource *payload;
+    size_t payload_bits;
+    size_t data_bit_idx;            // Next payload bit to compare
+    LSBITables tables;              // Only the block layouts are used
+    uint64_t changed[LSBI_PATTERN_COUNT];
+    uint64_t seen[LSBI_PATTERN_COUNT];
+} InversionStatsContext;
+
+/**
+ * @brief Row callback for PHASE 1: counts a span (Blue/Green only) with the vectorized kernel,
+ * one payload window of up to EMBED_WINDOW_PIXELS pixels at a time.
+ * The simulation puts 2 data bits in every pixel, so the span's first bit follows from its position.
+ */
+static void lsbi_stats_row_callback(const BMPSpan *span, void *ctx) {
+    InversionStatsContext *stats_ctx = (InversionStatsContext *)ctx;
+    unsigned char scratch[EMBED_WINDOW_BYTES];
+    const unsigned char *pixels = span->pixels;
+    size_t pixels_left = span->pixel_count;
+
+    stats_ctx->data_bit_idx = span->first_pixel * LSBI_BITS_PER_PIXEL;
+    while (pixels_left > 0 && stats_ctx->data_bit_idx < stats_ctx->payload_bits) {
+        size_t bits_left = stats_ctx->payload_bits - stats_ctx->data_bit_idx;
+        size_t count = pixels_left < EMBED_WINDOW_PIXELS ? pixels_left : EMBED_WINDOW_PIXELS;
+        if (count > bits_left / 2) {
+            count = bits_left / 2;
         }
 
-        // --- Step 6: Finalize and Assign Lengths ---
-        *data_size_out = (size_t)data_size;
-        *ext_len_out = ext_bytes_read + 1;
+        size_t first_byte = stats_ctx->data_bit_idx / 8;
+        size_t window_len;
+        const unsigned char *window = payload_window(stats_ctx->payload, first_byte, (stats_ctx->data_bit_idx + 2 * count + 7) / 8,
+                                                     scratch, &window_len);
+        lsbi_count_patterns(pixels, count, span->pixel_stride, window, window_len, stats_ctx->data_bit_idx - 8 * first_byte,
+                            &stats_ctx->tables, stats_ctx->changed, stats_ctx->seen);
+        stats_ctx->data_bit_idx += 2 * count;
+        pixels += count * span->pixel_stride;
+        pixels_left -= count;
+    }
+}
+
+/**
+ * @brief Reduction for PHASE 1: adds one worker's per-pattern histograms to the totals.
+ */
+static void merge_inversion_stats(void *ctx, const void *worker_ctx) {
+    InversionStatsContext *total = (InversionStatsContext *)ctx;
+    const InversionStatsContext *part = (const InversionStatsContext *)worker_ctx;
 
-        return data_buffer;
-    } else {
-        // Encrypted: Extension is inside encrypted data, not after it
-        // Just return the encrypted data buffer
-        *data_size_out = (size_t)data_size;
-        *ext_len_out = 0;  // Will be extracted after decryption
-        return data_buffer;
+    for (int i = 0; i < LSBI_PATTERN_COUNT; i++) {
+        total->changed[i] += part->changed[i];
+        total->seen[i] += part->seen[i];
     }
 }
 
 /**
  * @brief PHASE 1: Simulates LSB insertion to calculate the 4-bit inversion map.
+ * The carrier rows are read once, in place (mapped pixel array), and counted per pattern
+ * with SIMD compares and popcounts; PHASE 2 then embeds from the same mapping.
+ * With image->threads workers, each counts its own range of rows into private
+ * histograms that are summed at the end (one thread for sequential payloads).
  * @param image Pointer to the BMPImage structure.
- * @param secret_buffer The buffer containing the payload (Size|Data|Ext).
- * @param payload_bits Total number of payload bits (excluding control map).
+ * @param payload The payload (Size|Data|Ext), read window by window.
+ * @param payload_bits Total number of payload bits (excluding control map), a multiple of 8.
  * @param calculated_map_out Pointer to store the resulting 4-bit inversion map.
  * @return EXIT_SUCCESS or EXIT_FAILURE on read error.
  */
-static int calculate_inversion_map(BMPImage *image, const unsigned char *secret_buffer, size_t payload_bits, unsigned char *calculated_map_out) {
+static int calculate_inversion_map(BMPImage *image, PayloadSource *payload, size_t payload_bits, unsigned char *calculated_map_out) {
     PatternStats stats[LSBI_PATTERNS] = {0};
+    InversionStatsContext stats_ctx = {0};
 
-    if (fseek(image->in, image->fileHeader->bfOffBits, SEEK_SET) != 0) {
-        fprintf(stderr, "Error: Failed to reset file pointer for map calculation.\n");
+    if (!image->data || image->width == 0) {
+        fprintf(stderr, ERR_INVALID_BMP);
         return EXIT_FAILURE;
     }
 
-    Pixel current_pixel = {0};
-    size_t data_bit_idx = 0;
-
-    while (data_bit_idx < payload_bits) {
-        if (fread(&current_pixel, sizeof(Pixel), 1, image->in) != 1) {
-            fprintf(stderr, "Error: Unexpected EOF during LSBI simulation.\n");
-            return EXIT_FAILURE;
-        }
-
-        unsigned char *components[3] = {&(current_pixel.blue), &(current_pixel.green), &(current_pixel.red)};
-
-        for (int i = 0; i < 3; i++) {
-            if (data_bit_idx >= payload_bits) break;
-
-            // LSBI Rule: Skip the Red
-            if (i == 2) {
-                continue;
-            }
-
-            int secret_bit = get_nth_bit(secret_buffer, data_bit_idx);
-            unsigned char cover_value = *components[i];
-
-            unsigned char pattern = (cover_value >> 1) & 0x03;
+    // The simulation places 2 data bits (Blue, Green) in every pixel from pixel 0
+    size_t pixels = payload_bits / 2;
+    size_t rows = pixels / image->width + (pixels % image->width != 0);
+    if (rows > image->height) {
+        fprintf(stderr, "Error: Unexpected EOF during LSBI simulation.\n");
+        return EXIT_FAILURE;
+    }
 
-            if ((cover_value & 1) != secret_bit) {
-                stats[pattern].changed_count++;
-            } else {
-                stats[pattern].unchanged_count++;
-            }
+    stats_ctx.payload = payload;
+    stats_ctx.payload_bits = payload_bits;
+    lsbi_build_tables(&stats_ctx.tables, 0);
+    if (parallel_bmp_rows(image, (unsigned char *)image->data, 0, (uint32_t)rows, lsbi_stats_row_callback,
+                          &stats_ctx, payload->sequential ? 0 : sizeof(stats_ctx), merge_inversion_stats) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (payload->failed) {
+        fprintf(stderr, ERR_SECRET_READ);
+        return EXIT_FAILURE;
+    }
 
-            data_bit_idx++;
-        }
+    for (int i = 0; i < LSBI_PATTERNS; i++) {
+        stats[i].changed_count = stats_ctx.changed[i];
+        stats[i].unchanged_count = stats_ctx.seen[i] - stats_ctx.changed[i];
     }
 
     // Calculate the Final Map
@@ -172,36 +386,35 @@ static int calculate_inversion_map(BMPImage *image, const unsigned char *secret_
 /**
  * @brief PHASE 2: Performs the actual embedding using the calculated inversion map.
  * @param image Pointer to the BMPImage structure.
- * @param secret_buffer The buffer containing the payload (Size|Data|Ext).
- * @param buffer_len Total payload length in bytes.
+ * @param payload The payload (Size|Data|Ext), read window by window.
  * @param inversion_map The 4-bit map calculated in Phase 1.
  * @param required_bits The total number of bits to hide (payload + control).
  * @return EXIT_SUCCESS or EXIT_FAILURE on write error or premature finish.
  */
-static int perform_final_embedding(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len, unsigned char inversion_map, size_t required_bits) {
-    // Reset file pointer to the start of pixel data for the final embedding pass
-    if (fseek(image->in, image->fileHeader->bfOffBits, SEEK_SET) != 0) {
-        fprintf(stderr, "Error: Failed to reset file pointer for final embedding.\n");
-        return EXIT_FAILURE;
-    }
-
+static int perform_final_embedding(BMPImage *image, PayloadSource *payload, unsigned char inversion_map, size_t required_bits) {
     // Configure the context with the calculated map
     StegoContext ctx = {
-            .data_buffer = (unsigned char *)secret_buffer,
-            .data_buffer_len = buffer_len,
+            .payload = payload,
+            .data_buffer_len = payload->len,
             .current_bit_idx = 0, // Starts at 0, ready to embed the 4-bit map first
             .inversion_map = inversion_map
     };
 
-    // Write headers to the output file before iterating through pixels
-    if (fwrite(image->fileHeader, sizeof(BMPFileHeader), 1, image->out) != 1 ||
-        fwrite(image->infoHeader, sizeof(BMPInfoHeader), 1, image->out) != 1) {
+    // Every cover byte's output only depends on (bit, byte) once the map is known
+    LSBITables tables;
+    lsbi_build_tables(&tables, inversion_map);
+    ctx.lsbi_tables = &tables;
+
+    // Write the output. The callback handles the map (LSB1) and the payload (LSBI); rows may go to different workers.
+    size_t ctx_size = payload->sequential ? 0 : sizeof(ctx);
+    if (write_bmp_rows(image, pixels_for_bits(required_bits, LSBI_BITS_PER_PIXEL), lsbi_embed_row_callback, &ctx, ctx_size) != 0) {
         fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
         return EXIT_FAILURE;
     }
-
-    // Invoke iteration. The callback handles the map (LSB1) and the payload (LSBI).
-    iterate_bmp(image, lsbi_embed_pixel_callback, &ctx);
+    if (payload->failed) {
+        fprintf(stderr, ERR_SECRET_READ);
+        return EXIT_FAILURE;
+    }
 
     // Verification
     if (ctx.current_bit_idx < required_bits) {
@@ -212,172 +425,113 @@ static int perform_final_embedding(BMPImage *image, const unsigned char *secret_
     return EXIT_SUCCESS;
 }
 
-// -------------------------------------- LSB1 --------------------------------------
+// -------------------------------------- LSBn (LSB1 - LSB4) --------------------------------------
 /**
- * @brief Callback for LSB1: modifies a pixel by inserting 3 bits of the secret message.
- * * Inserts one bit into the LSB of Blue, then Green, then Red (BGR order).
+ * @brief Row callback for LSBn: stream bit k always lands in component k / n, so the span's
+ * own position gives its first bit and any row can be embedded independently
+ * (parallel_bmp_rows). The span is embedded one payload window of up to EMBED_WINDOW_PIXELS
+ * pixels at a time; 24-bit windows go through lsbn_embed_bytes as one flat run of
+ * components, 32-bit ones three components (one pixel) at a time so alpha is skipped.
  */
-void lsb1_embed_pixel_callback(Pixel *pixel, void *ctx) {
+void lsbn_embed_row_callback(const BMPSpan *span, void *ctx) {
     StegoContext *stego_ctx = (StegoContext *)ctx;
-
-    if (stego_ctx->current_bit_idx >= stego_ctx->data_buffer_len * 8) {
-        return;
-    }
-
-    unsigned char *components[3] = {&(pixel->blue), &(pixel->green), &(pixel->red)};
-
-    for (int i = 0; i < 3; i++) {
-        if (stego_ctx->current_bit_idx >= stego_ctx->data_buffer_len * 8) {
-            return;
+    const size_t n = (size_t)stego_ctx->bits_per_component;
+    const size_t total_bits = stego_ctx->data_buffer_len * 8;
+    // Windows start on a byte where a component starts too: any byte for n = 1, 2, 4, every third for n = 3
+    const size_t group = n == 3 ? 3 : 1;
+    unsigned char scratch[EMBED_WINDOW_BYTES];
+    unsigned char *pixels = span->pixels;
+    size_t pixels_left = span->pixel_count;
+    size_t component = span->first_pixel * 3;
+
+    while (pixels_left > 0 && component * n < total_bits) {
+        size_t window_pixels = pixels_left < EMBED_WINDOW_PIXELS ? pixels_left : EMBED_WINDOW_PIXELS;
+
+        // Components that still take payload bits (with n = 3 the last one may be partly padding)
+        size_t count = (total_bits - component * n + n - 1) / n;
+        if (count > window_pixels * 3) {
+            count = window_pixels * 3;
         }
 
-        // 1. Get the secret bit (0 or 1)
-        int secret_bit = get_nth_bit(stego_ctx->data_buffer, stego_ctx->current_bit_idx);
+        size_t first_byte = component * n / (8 * group) * group;
+        load_embed_window(stego_ctx, first_byte, ((component + count) * n + 7) / 8, scratch);
+        size_t window_component = component - first_byte * 8 / n;
 
-        // 2. Clear the LSB of the component (AND with 0xFE = 1111 1110)
-        *components[i] &= 0xFE;
-
-        // 3. Insert the secret bit (OR with 0 or 1)
-        *components[i] |= secret_bit;
+        if (span->pixel_stride == BGR_PIXEL_SIZE) {
+            lsbn_embed_bytes(stego_ctx->bits_per_component, pixels, stego_ctx->window, stego_ctx->window_len,
+                             window_component, count);
+        } else {
+            unsigned char *pixel = pixels;
+            for (size_t done = 0; done < count; pixel += span->pixel_stride) {
+                size_t pixel_count = count - done < 3 ? count - done : 3;
+                lsbn_embed_bytes(stego_ctx->bits_per_component, pixel, stego_ctx->window, stego_ctx->window_len,
+                                 window_component + done, pixel_count);
+                done += pixel_count;
+            }
+        }
 
-        // Advance to the next bit to hide
-        stego_ctx->current_bit_idx++;
+        component += count;
+        pixels += window_pixels * span->pixel_stride;
+        pixels_left -= window_pixels;
     }
+
+    stego_ctx->current_bit_idx = component * n < total_bits ? component * n : total_bits;
 }
 
+int embed_lsbn(BMPImage *image, PayloadSource *payload, int bits_per_component) {
+    if (bits_per_component < 1 || bits_per_component > LSBN_MAX_BITS) {
+        fprintf(stderr, "Error: LSBn supports 1 to %d bits per component (got %d).\n", LSBN_MAX_BITS, bits_per_component);
+        return EXIT_FAILURE;
+    }
 
-int embed_lsb1(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len) {
     StegoContext ctx = {
-            .data_buffer = (unsigned char *)secret_buffer,
-            .data_buffer_len = buffer_len,
+            .payload = payload,
+            .data_buffer_len = payload->len,
             .current_bit_idx = 0,
-            .inversion_map = 0
+            .inversion_map = 0,
+            .bits_per_component = bits_per_component
     };
 
-    if (fwrite(image->fileHeader, sizeof(BMPFileHeader), 1, image->out) != 1 ||
-        fwrite(image->infoHeader, sizeof(BMPInfoHeader), 1, image->out) != 1) {
+    // Write the output: only the pixels that receive payload bits go through the callback
+    // (on one thread for sequential payloads, which are cheapest to read front to back)
+    size_t required_bits = payload->len * 8;
+    size_t ctx_size = payload->sequential ? 0 : sizeof(ctx);
+    if (write_bmp_rows(image, pixels_for_bits(required_bits, 3 * bits_per_component), lsbn_embed_row_callback, &ctx, ctx_size) != 0) {
         fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
         return EXIT_FAILURE;
     }
+    if (payload->failed) {
+        fprintf(stderr, ERR_SECRET_READ);
+        return EXIT_FAILURE;
+    }
 
-    // 3. Process Pixels (Read from image->in, modify, write to image->out)
-    iterate_bmp(image, lsb1_embed_pixel_callback, &ctx);
-
-    // 4. Verification (Optional but recommended)
-    size_t required_bits = buffer_len * 8;
     if (ctx.current_bit_idx < required_bits) {
         fprintf(stderr, "Warning: Steganography process finished prematurely. %zu bits of %zu were written.\n", ctx.current_bit_idx, required_bits);
-        // We still treat this as a success if the process didn't crash, but it's noted.
     }
 
     return EXIT_SUCCESS;
 }
 
-static int get_next_byte_lsb1(BMPImage *image, ExtractionContext *ctx) {
-    unsigned char assembled_byte = 0;
-    for (int i = 0; i < 8; i++) {
-        int bit = extract_next_bit(image, &ctx->bit_count, &ctx->current_pixel);
-        if (bit == -1) return -1;
-
-        size_t bit_pos = 7 - i;
-        if (bit) {
-            assembled_byte |= (1 << bit_pos);
-        }
-    }
-    return (int)assembled_byte;
-}
-
-unsigned char *lsb1_extract(BMPImage *image, size_t *extracted_data_len, size_t *extension_len, char encrypted) {
-    ExtractionContext ctx = {0};
-    return extract_payload_generic(image, extracted_data_len, extension_len, get_next_byte_lsb1, &ctx, encrypted);
+static int get_next_block_lsbn(BMPImage *image, ExtractionContext *ctx, unsigned char *out, size_t len) {
+    return extract_lsbn_block(image, ctx->bits_per_component, &ctx->bit_count, out, len);
 }
 
-// -------------------------------------- LSB4 --------------------------------------
-/**
- * @brief Callback for LSB4: modifies a pixel by inserting 12 bits of the secret message.
- * * Inserts one bit into the LSB of Blue, then Green, then Red (BGR order).
- */
-void lsb4_embed_pixel_callback(Pixel *pixel, void *ctx) {
-    StegoContext *stego_ctx = (StegoContext *)ctx;
-    const size_t total_bits = stego_ctx->data_buffer_len * 8;
-
-    if (stego_ctx->current_bit_idx >= total_bits) {
-        return;
-    }
-
-    unsigned char *components[3] = {&(pixel->blue), &(pixel->green), &(pixel->red)};
-
-    for (int i = 0; i < 3; i++) {
-        if (stego_ctx->current_bit_idx >= total_bits) {
-            return;
-        }
-
-        size_t byte_idx = stego_ctx->current_bit_idx / 8;
-        size_t bit_offset = stego_ctx->current_bit_idx % 8;
-        unsigned char secret_4_bits;
-
-        // 1. Get the secret nibble (4 bits) in MSB-first order
-        if (bit_offset == 0) {
-            secret_4_bits = (stego_ctx->data_buffer[byte_idx] >> 4) & 0x0F;
-        } else {
-            secret_4_bits = stego_ctx->data_buffer[byte_idx] & 0x0F;
-        }
-
-        // 2. Clear the 4 LSBs of the component (AND con 0xF0 = 1111 0000)
-        *components[i] &= 0xF0;
-
-        // 3. Insert the secret nibble (OR)
-        *components[i] |= secret_4_bits;
-
-        // Advance the index by 4 bits (un nibble)
-        stego_ctx->current_bit_idx += 4;
-    }
+static uint64_t skip_payload_lsbn(uint64_t bit_count, uint64_t bytes) {
+    return bit_count + bytes * 8;   // LSBn counts stream bits, whatever n is
 }
 
-
-int embed_lsb4(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len) {
-    StegoContext ctx = {
-            .data_buffer = (unsigned char *)secret_buffer,
-            .data_buffer_len = buffer_len,
-            .current_bit_idx = 0,
-            .inversion_map = 0
-    };
-
-    if (fwrite(image->fileHeader, sizeof(BMPFileHeader), 1, image->out) != 1 ||
-        fwrite(image->infoHeader, sizeof(BMPInfoHeader), 1, image->out) != 1) {
-        fprintf(stderr, ERR_FAILED_TO_WRITE_BMP);
+int lsbn_extract(BMPImage *image, int bits_per_component, char encrypted, payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    if (bits_per_component < 1 || bits_per_component > LSBN_MAX_BITS) {
+        fprintf(stderr, "Error: LSBn supports 1 to %d bits per component (got %d).\n", LSBN_MAX_BITS, bits_per_component);
         return EXIT_FAILURE;
     }
 
-    iterate_bmp(image, lsb4_embed_pixel_callback, &ctx);
-
-    size_t required_bits = buffer_len * 8;
-    if (ctx.current_bit_idx < required_bits) {
-        fprintf(stderr, "Warning: Steganography process finished prematurely. %zu bits of %zu were written.\n", ctx.current_bit_idx, required_bits);
-    }
-
-    return EXIT_SUCCESS;
-}
-
-static int get_next_byte_lsb4(BMPImage *image, ExtractionContext *ctx) {
-    unsigned char output_byte = 0;
-
-    // NIBBLE 1 (MSB)
-    unsigned char nibble1 = extract_nibble(image, &ctx->bit_count, &ctx->current_pixel);
-    if (nibble1 == 0xFF) return -1;
-    output_byte |= (nibble1 << 4);
-
-    // NIBBLE 2 (LSB)
-    unsigned char nibble2 = extract_nibble(image, &ctx->bit_count, &ctx->current_pixel);
-    if (nibble2 == 0xFF) return -1;
-    output_byte |= nibble2;
-
-    return (int)output_byte;
-}
-
-unsigned char *lsb4_extract(BMPImage *image, size_t *extracted_data_len, size_t *extension_len, char encrypted) {
-    ExtractionContext ctx = {0};
-    return extract_payload_generic(image, extracted_data_len, extension_len, get_next_byte_lsb4, &ctx, encrypted);
+    PayloadReader reader = {
+            .ctx = { .bits_per_component = bits_per_component },
+            .read = get_next_block_lsbn,
+            .skip = skip_payload_lsbn
+    };
+    return extract_payload_generic(image, &reader, encrypted, 3 * bits_per_component, sink, sink_ctx, info);
 }
 
 // -------------------------------------- LSBI --------------------------------------
@@ -423,7 +577,7 @@ void lsbi_embed_pixel_callback(Pixel *pixel, void *ctx) {
         }
 
         size_t data_bit_idx = stego_ctx->current_bit_idx - control_limit;
-        int bit_to_insert = get_nth_bit(stego_ctx->data_buffer, data_bit_idx);
+        int bit_to_insert = get_nth_bit(stego_ctx->window, data_bit_idx - 8 * stego_ctx->window_first_byte);
 
         unsigned char original_value = *components[i];
         unsigned char pattern = (original_value >> 1) & 0x03;
@@ -441,8 +595,78 @@ void lsbi_embed_pixel_callback(Pixel *pixel, void *ctx) {
     }
 }
 
-int embed_lsbi(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len) {
-    const size_t payload_bits = buffer_len * 8;
+/**
+ * @brief LSBI kernel over `count` pixels spaced `stride` bytes apart (3 = BGR, 4 = BGRA).
+ * Once the control map is written, each pixel takes two payload bits in Blue and Green
+ * (Red and alpha are left untouched): the whole run goes through the table-driven
+ * lsbi_embed_span. The map and a trailing odd bit go through the pixel callback.
+ */
+static void lsbi_embed_pixels(unsigned char *pixels, size_t count, size_t stride, StegoContext *stego_ctx, const LSBITables *tables) {
+    const size_t total_bits = (stego_ctx->data_buffer_len * 8) + LSBI_CONTROL_BITS;
+    size_t i = 0;
+
+    for (; i < count && stego_ctx->current_bit_idx < LSBI_CONTROL_BITS; i++, pixels += stride) {
+        lsbi_embed_pixel_callback((Pixel *)pixels, stego_ctx);
+    }
+
+    size_t bit_idx = stego_ctx->current_bit_idx;
+    if (i == count || bit_idx >= total_bits) {
+        return;
+    }
+
+    // Whole pixels with two payload bits each
+    size_t run = (total_bits - bit_idx) / 2;
+    if (run > count - i) {
+        run = count - i;
+    }
+    lsbi_embed_span(pixels, run, stride, stego_ctx->window, stego_ctx->window_len,
+                    bit_idx - LSBI_CONTROL_BITS - 8 * stego_ctx->window_first_byte, tables);
+    stego_ctx->current_bit_idx = bit_idx + 2 * run;
+
+    // A single payload bit left: Blue of the next pixel
+    if (i + run < count && stego_ctx->current_bit_idx < total_bits) {
+        lsbi_embed_pixel_callback((Pixel *)(pixels + run * stride), stego_ctx);
+    }
+}
+
+/**
+ * @brief Row callback for LSBI: runs the table-driven kernel over a span, one payload window
+ * of up to EMBED_WINDOW_PIXELS pixels at a time.
+ * Pixel 0 holds control bits 0-2, pixel 1 control bit 3 and data bit 0, and every later
+ * pixel p two data bits starting at stream bit 2p + 1 (data bit 2p - 3), so any row can
+ * start on its own.
+ */
+void lsbi_embed_row_callback(const BMPSpan *span, void *ctx) {
+    StegoContext *stego_ctx = (StegoContext *)ctx;
+    const size_t total_bits = (stego_ctx->data_buffer_len * 8) + LSBI_CONTROL_BITS;
+    unsigned char scratch[EMBED_WINDOW_BYTES];
+    LSBITables local_tables;
+    const LSBITables *tables = stego_ctx->lsbi_tables;
+    unsigned char *pixels = span->pixels;
+    size_t pixel = span->first_pixel;
+    size_t pixels_left = span->pixel_count;
+
+    if (!tables) {
+        lsbi_build_tables(&local_tables, stego_ctx->inversion_map);
+        tables = &local_tables;
+    }
+
+    stego_ctx->current_bit_idx = pixel == 0 ? 0 : pixel * LSBI_BITS_PER_PIXEL + 1;
+    while (pixels_left > 0 && stego_ctx->current_bit_idx < total_bits) {
+        size_t window_pixels = pixels_left < EMBED_WINDOW_PIXELS ? pixels_left : EMBED_WINDOW_PIXELS;
+        size_t first_data_bit = pixel < 2 ? 0 : 2 * pixel - 3;
+
+        load_embed_window(stego_ctx, first_data_bit / 8, (2 * (pixel + window_pixels) + 7) / 8, scratch);
+        lsbi_embed_pixels(pixels, window_pixels, span->pixel_stride, stego_ctx, tables);
+
+        pixel += window_pixels;
+        pixels += window_pixels * span->pixel_stride;
+        pixels_left -= window_pixels;
+    }
+}
+
+int embed_lsbi(BMPImage *image, PayloadSource *payload) {
+    const size_t payload_bits = payload->len * 8;
     const size_t required_bits = payload_bits + LSBI_CONTROL_BITS;
     unsigned char inversion_map = 0;
 
@@ -451,106 +675,307 @@ int embed_lsbi(BMPImage *image, const unsigned char *secret_buffer, size_t buffe
         return EXIT_FAILURE;
     }
 
-    if (calculate_inversion_map(image, secret_buffer, payload_bits, &inversion_map) != EXIT_SUCCESS) {
+    // The map is computed on the carrier pixels, before the output is written; a streamed
+    // carrier keeps just the rows that will be modified in memory for that
+    if (load_bmp_pixels(image, pixels_for_bits(required_bits, LSBI_BITS_PER_PIXEL)) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (calculate_inversion_map(image, payload, payload_bits, &inversion_map) != EXIT_SUCCESS) {
         return EXIT_FAILURE;
     }
 
-    return perform_final_embedding(image, secret_buffer, buffer_len, inversion_map, required_bits);
+    return perform_final_embedding(image, payload, inversion_map, required_bits);
 }
 
-unsigned char *lsbi_extract(BMPImage *image, size_t *extracted_data_len, size_t *extension_len, char encrypted) {
-    if (!image || !image->in) {
-        fprintf(stderr, ERR_INVALID_BMP);
-        return NULL;
+/**
+ * @brief Reads the 4-bit inversion map from the LSBs of the first 4 components (LSB1 order).
+ * @return 0 on success, -1 if the image is too small.
+ */
+static int read_inversion_map(BMPImage *image, unsigned char *inversion_map) {
+    unsigned char control[LSBI_CONTROL_BITS];
+
+    if (load_bmp_pixels(image, (LSBI_CONTROL_BITS + 2) / 3) != 0 ||
+        gather_components(image, 0, control, LSBI_CONTROL_BITS) != 0) {
+        return -1;
     }
+    *inversion_map = 0;
+    for (int i = 0; i < LSBI_CONTROL_BITS; i++) {
+        *inversion_map |= (unsigned char)((control[i] & 1) << i);
+    }
+    return 0;
+}
 
-    unsigned char inversion_map = 0;
-    unsigned char size_buffer[4] = {0};
-    Pixel current_pixel = {0};
-    int bit_count = 0;
-    uint32_t data_size = 0;
-    long max_capacity_bytes = get_pixel_count(image) * 3 / 8;
+static int get_next_block_lsbi(BMPImage *image, ExtractionContext *ctx, unsigned char *out, size_t len) {
+    return extract_lsbi_block(image, &ctx->bit_count, ctx->lsbi_tables, out, len);
+}
 
-    // --- Step 1: Extract Control Map (4 bits, LSB1 Standard) ---
-    for (int i = 0; i < LSBI_CONTROL_BITS; i++) {
-        int extracted_lsb = extract_next_bit(image, &bit_count, &current_pixel);
-        if (extracted_lsb == -1) return NULL;
-        if (extracted_lsb) {
-            inversion_map |= (1 << i);
-        }
+/**
+ * @brief LSBI data bits run over Blue and Green only: a pending Red is skipped, then the
+ * position in that B/G stream is advanced and mapped back to a component.
+ */
+static uint64_t skip_payload_lsbi(uint64_t bit_count, uint64_t bytes) {
+    if (bit_count % 3 == 2) {
+        bit_count++;
     }
+    uint64_t data_bit = 2 * (bit_count / 3) + bit_count % 3 + bytes * 8;
+    return (data_bit / 2) * 3 + data_bit % 2;
+}
 
-    // --- Step 2: Extract Header (4 Bytes, using LSBI Logic) ---
-    for (int i = 0; i < 4; i++) {
-        int extracted_byte = extract_msb_byte(image, &bit_count, &current_pixel, inversion_map, lsbi_extract_data_bit);
-        if (extracted_byte == -1) return NULL;
-        size_buffer[i] = (unsigned char)extracted_byte;
+/**
+ * @brief Positions an LSBI reader after the control map, which is read here, and builds
+ * the decoding tables of that map once for the whole extraction.
+ * @return 0 on success, -1 if the image is too small.
+ */
+static int open_lsbi_reader(BMPImage *image, PayloadReader *reader) {
+    memset(reader, 0, sizeof(*reader));
+    if (read_inversion_map(image, &reader->ctx.inversion_map) != 0) {
+        return -1;
     }
+    lsbi_build_tables(&reader->lsbi_tables, reader->ctx.inversion_map);
+    reader->ctx.lsbi_tables = &reader->lsbi_tables;
+    reader->ctx.bit_count = LSBI_CONTROL_BITS;
+    reader->ctx.bits_per_component = 1;     // LSBI positions count components
+    reader->read = get_next_block_lsbi;
+    reader->skip = skip_payload_lsbi;
+    return 0;
+}
 
-    data_size = read_size_header(size_buffer);
-    if (data_size == 0 || data_size > max_capacity_bytes) return NULL;
+int lsbi_extract(BMPImage *image, char encrypted, payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    if (!image) {
+        fprintf(stderr, ERR_INVALID_BMP);
+        return EXIT_FAILURE;
+    }
 
-    // --- Step 3: Allocate memory for Data + Extension ---
-    size_t total_data_allocation = (size_t)data_size + MAX_EXT_LEN;
-    unsigned char *data_buffer = malloc(total_data_allocation);
-    if (!data_buffer) return NULL;
-    memset(data_buffer, 0, total_data_allocation);
-    size_t current_byte_idx = 0;
+    // --- Step 1: Extract Control Map (4 bits, LSB1 Standard) ---
+    PayloadReader reader;
+    if (open_lsbi_reader(image, &reader) != 0) {
+        fprintf(stderr, "Error: Failed to read pixel data during extraction.\n");
+        return EXIT_FAILURE;
+    }
 
-    // --- Step 4: Extract Data (data_size bytes) ---
-    while (current_byte_idx < data_size) {
-        int extracted_byte = extract_msb_byte(image, &bit_count, &current_pixel, inversion_map, lsbi_extract_data_bit);
-        if (extracted_byte == -1) {
-            fprintf(stderr, "Error: Unexpected end of file during data extraction.\n");
-            free(data_buffer);
-            return NULL;
+    // --- Step 2: Header, data and extension from the Blue/Green bits (LSBI logic) ---
+    return extract_payload_generic(image, &reader, encrypted, LSBI_BITS_PER_PIXEL, sink, sink_ctx, info);
+}
+
+// -------------------------------------- Algorithm registry --------------------------------------
+
+static int embed_lsbn_entry(const StegoAlgorithm *algorithm, BMPImage *image, PayloadSource *payload) {
+    return embed_lsbn(image, payload, algorithm->bits_per_component);
+}
+
+static int extract_lsbn_entry(const StegoAlgorithm *algorithm, BMPImage *image, char encrypted,
+                              payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    return lsbn_extract(image, algorithm->bits_per_component, encrypted, sink, sink_ctx, info);
+}
+
+static int embed_lsbi_entry(const StegoAlgorithm *algorithm, BMPImage *image, PayloadSource *payload) {
+    (void)algorithm;
+    return embed_lsbi(image, payload);
+}
+
+static int extract_lsbi_entry(const StegoAlgorithm *algorithm, BMPImage *image, char encrypted,
+                              payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    (void)algorithm;
+    return lsbi_extract(image, encrypted, sink, sink_ctx, info);
+}
+
+/**
+ * @brief LSBn streams start at component 0 and are addressed by stream bit.
+ */
+static int open_reader_lsbn(const StegoAlgorithm *algorithm, BMPImage *image, PayloadReader *reader) {
+    (void)image;
+    memset(reader, 0, sizeof(*reader));
+    reader->ctx.bits_per_component = algorithm->bits_per_component;
+    reader->read = get_next_block_lsbn;
+    reader->skip = skip_payload_lsbn;
+    return 0;
+}
+
+/**
+ * @brief LSBI streams start after the control map, which is read here.
+ */
+static int open_reader_lsbi(const StegoAlgorithm *algorithm, BMPImage *image, PayloadReader *reader) {
+    (void)algorithm;
+    return open_lsbi_reader(image, reader);
+}
+
+static const StegoAlgorithm STEGO_ALGORITHMS[] = {
+    {"LSB1", 1, LSB1_BITS_PER_PIXEL, 0, embed_lsbn_entry, extract_lsbn_entry, open_reader_lsbn},
+    {"LSB2", 2, LSB2_BITS_PER_PIXEL, 0, embed_lsbn_entry, extract_lsbn_entry, open_reader_lsbn},
+    {"LSB3", 3, LSB3_BITS_PER_PIXEL, 0, embed_lsbn_entry, extract_lsbn_entry, open_reader_lsbn},
+    {"LSB4", 4, LSB4_BITS_PER_PIXEL, 0, embed_lsbn_entry, extract_lsbn_entry, open_reader_lsbn},
+    {"LSBI", 1, LSBI_BITS_PER_PIXEL, LSBI_CONTROL_BITS, embed_lsbi_entry, extract_lsbi_entry, open_reader_lsbi},
+};
+
+#define STEGO_ALGORITHM_COUNT (sizeof(STEGO_ALGORITHMS) / sizeof(STEGO_ALGORITHMS[0]))
+
+const StegoAlgorithm *find_stego_algorithm(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+    for (size_t i = 0; i < STEGO_ALGORITHM_COUNT; i++) {
+        if (strcmp(name, STEGO_ALGORITHMS[i].name) == 0) {
+            return &STEGO_ALGORITHMS[i];
         }
-        data_buffer[current_byte_idx] = (unsigned char)extracted_byte;
-        current_byte_idx++;
+    }
+    return NULL;
+}
+
+int check_stego_capacity(const StegoAlgorithm *algorithm, const BMPImage *image, size_t buffer_len) {
+    return check_bmp_capacity(image, buffer_len * 8 + algorithm->control_bits, algorithm->bits_per_pixel);
+}
+
+/**
+ * @brief First step of peek_payload: opens a reader and reads the size header (and, when
+ * encrypted, the first ciphertext bytes). The reader is left right after what was read.
+ * @param available Set to the payload bytes the carrier holds after the size header.
+ * @return EXIT_SUCCESS if the size is plausible, EXIT_FAILURE otherwise (nothing printed).
+ */
+static int peek_size_header(const StegoAlgorithm *algorithm, BMPImage *image, char encrypted, PayloadReader *reader,
+                            StegoPayloadInfo *info, uint64_t *available) {
+    unsigned char header[4];
+
+    memset(info, 0, sizeof(*info));
+    if (!image || algorithm->open_reader(algorithm, image, reader) != 0) {
+        return EXIT_FAILURE;
     }
 
-    // --- Step 5: If encrypted the extension is in the data buffer ---
+    // Payload bytes the carrier holds after the control bits: every read below stays inside them
+    uint64_t capacity_bits = get_capacity_bits(image, algorithm->bits_per_pixel);
+    if (capacity_bits < algorithm->control_bits + 8 * sizeof(header)) {
+        return EXIT_FAILURE;
+    }
+    *available = (capacity_bits - algorithm->control_bits) / 8 - sizeof(header);
+
+    if (read_payload_bytes(image, reader, header, sizeof(header)) != 0) {
+        return EXIT_FAILURE;
+    }
+    info->data_size = read_size_header(header);
+    if (info->data_size == 0 || info->data_size > *available) {
+        return EXIT_FAILURE;
+    }
     if (encrypted) {
-        *extracted_data_len = (size_t)data_size;
-        *extension_len = 0;
-        return data_buffer;
+        // The extension is inside the ciphertext: keep its first bytes for the caller to check
+        info->head_len = info->data_size < PAYLOAD_HEAD_LEN ? info->data_size : PAYLOAD_HEAD_LEN;
+        return read_payload_bytes(image, reader, info->head, info->head_len) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
 
-    // --- Step 6: Extract Extension (Sequentially until '\0') ---
-    size_t ext_bytes_read = 0;
-    size_t ext_start_byte = data_size;
+/**
+ * @brief Second step of peek_payload: jumps over skip_len data bytes to the extension, which
+ * must start with '.' and end with '\0' within MAX_EXT_LEN bytes, and reads it into info.
+ * @param ext_room Payload bytes the carrier holds from the extension on.
+ * @param release Drop the rows jumped over (streamed carriers): the reader cannot go back to them.
+ * @return EXIT_SUCCESS if the extension is valid, EXIT_FAILURE otherwise.
+ */
+static int peek_extension(BMPImage *image, PayloadReader *reader, uint64_t skip_len, uint64_t ext_room, char release,
+                          StegoPayloadInfo *info) {
+    unsigned char ext[MAX_EXT_LEN];
+    size_t ext_read = ext_room < MAX_EXT_LEN ? (size_t)ext_room : MAX_EXT_LEN;
 
-    while (ext_bytes_read < MAX_EXT_LEN) {
-        int extracted_byte = extract_msb_byte(image, &bit_count, &current_pixel, inversion_map, lsbi_extract_data_bit);
-        if (extracted_byte == -1) {
-            fprintf(stderr, "Error: Unexpected end of file before finding extension terminator.\n");
-            free(data_buffer);
-            return NULL;
-        }
+    if (ext_read < 2) {
+        return EXIT_FAILURE;
+    }
+    reader->ctx.bit_count = reader->skip(reader->ctx.bit_count, skip_len);
+    if (release && release_payload_rows(image, &reader->ctx) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (read_payload_bytes(image, reader, ext, ext_read) != 0) {
+        return EXIT_FAILURE;
+    }
 
-        data_buffer[ext_start_byte + ext_bytes_read] = (unsigned char)extracted_byte;
-        if (data_buffer[ext_start_byte + ext_bytes_read] == '\0') {
-            break;
+    const unsigned char *terminator = memchr(ext, '\0', ext_read);
+    if (ext[0] != '.' || !terminator) {
+        return EXIT_FAILURE;
+    }
+    info->extension_len = (size_t)(terminator - ext) + 1;
+    memcpy(info->extension, ext, info->extension_len);
+    return EXIT_SUCCESS;
+}
+
+int peek_payload(const StegoAlgorithm *algorithm, BMPImage *image, char encrypted, StegoPayloadInfo *info) {
+    PayloadReader reader;
+    uint64_t available = 0;
+
+    if (peek_size_header(algorithm, image, encrypted, &reader, info, &available) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (encrypted) {
+        return EXIT_SUCCESS;
+    }
+    return peek_extension(image, &reader, info->data_size, available - info->data_size, TRUE, info);
+}
+
+const StegoAlgorithm *detect_stego_algorithm(BMPImage *image, char encrypted, payload_check_func_t check, void *check_ctx) {
+    StegoPayloadInfo info;
+    PayloadReader reader;
+    uint64_t available;
+
+    for (size_t i = 0; i < STEGO_ALGORITHM_COUNT; i++) {
+        int found = peek_size_header(&STEGO_ALGORITHMS[i], image, encrypted, &reader, &info, &available);
+        // The extraction restarts at the first row, so the rows a probe reads stay in memory:
+        // on a streamed carrier only extensions within STREAM_PROBE_BYTES are probed
+        if (found == EXIT_SUCCESS && !encrypted) {
+            found = image->in_streamed && info.data_size > STREAM_PROBE_BYTES
+                    ? EXIT_FAILURE
+                    : peek_extension(image, &reader, info.data_size, available - info.data_size, FALSE, &info);
+        }
+        if (found == EXIT_SUCCESS && (!check || check(&info, check_ctx))) {
+            return &STEGO_ALGORITHMS[i];
         }
-        ext_bytes_read++;
     }
+    return NULL;
+}
 
-    if (ext_bytes_read >= MAX_EXT_LEN) {
-        fprintf(stderr, "Error: Extension length exceeded maximum allowed size (%d bytes) without terminator.\n", MAX_EXT_LEN);
-        free(data_buffer);
-        return NULL;
+int extract_payload_range(const StegoAlgorithm *algorithm, BMPImage *image, uint64_t offset, uint64_t length,
+                          payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info) {
+    PayloadReader reader;
+    uint64_t available = 0;
+
+    // Size header and extension first: they bound the range and name the output. A streamed
+    // carrier cannot come back to the range, so its extension is read after it
+    if (peek_size_header(algorithm, image, FALSE, &reader, info, &available) != EXIT_SUCCESS ||
+        (!image->in_streamed &&
+         peek_extension(image, &reader, info->data_size, available - info->data_size, FALSE, info) != EXIT_SUCCESS)) {
+        fprintf(stderr, "Error: No valid %s payload header found.\n", algorithm->name);
+        return EXIT_FAILURE;
+    }
+    if (offset >= info->data_size) {
+        fprintf(stderr, "Error: Offset %" PRIu64 " is past the end of the hidden file (%u bytes).\n", offset, info->data_size);
+        return EXIT_FAILURE;
+    }
+    if (length == 0 || length > info->data_size - offset) {
+        length = info->data_size - offset;
     }
 
-    ext_start_byte = data_size; // Re-definimos esto aquí para la validación
-    if (ext_bytes_read == 0 || data_buffer[ext_start_byte] != '.') {
-        fprintf(stderr, "Error: Extracted extension does not start with '.' (Invalid format).\n");
-        free(data_buffer);
-        return NULL;
+    // Byte `offset` of the file is byte 4 + offset of the stream: jump there and decode only the range
+    if (algorithm->open_reader(algorithm, image, &reader) != 0) {
+        return EXIT_FAILURE;
+    }
+    reader.ctx.bit_count = reader.skip(reader.ctx.bit_count, sizeof(uint32_t) + offset);
+    if (release_payload_rows(image, &reader.ctx) != 0 ||
+        stream_payload_bytes(image, &reader, length, sink, sink_ctx) != 0) {
+        return EXIT_FAILURE;
     }
 
-    // --- Step 7: Finalize and Assign Lengths ---
-    *extracted_data_len = (size_t)data_size;
-    *extension_len = ext_bytes_read + 1;
+    if (image->in_streamed &&
+        peek_extension(image, &reader, info->data_size - offset - length, available - info->data_size, TRUE, info) != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: No valid %s payload extension found.\n", algorithm->name);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int read_payload_data(const StegoAlgorithm *algorithm, BMPImage *image, uint64_t offset, unsigned char *out, size_t len) {
+    PayloadReader reader;
 
-    return data_buffer;
-}
\ No newline at end of file
+    if (!image || algorithm->open_reader(algorithm, image, &reader) != 0) {
+        return EXIT_FAILURE;
+    }
+    reader.ctx.bit_count = reader.skip(reader.ctx.bit_count, sizeof(uint32_t) + offset);
+    if (release_payload_rows(image, &reader.ctx) != 0) {
+        return EXIT_FAILURE;
+    }
+    return read_payload_bytes(image, &reader, out, len) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
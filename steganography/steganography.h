@@ -4,130 +4,233 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "../bmp_lib.h"
+#include "embed_utils.h"
+#include "lsb_kernels.h"
 
 #define LSBI_PATTERNS 4 // 00, 01, 10, 11
 #define MAX_EXT_LEN 256
+#define PAYLOAD_HEAD_LEN 32    // Data bytes kept by peek_payload (enough for two cipher blocks)
+#define STREAM_PROBE_BYTES (256 * 1024)  // Largest payload whose extension detect_stego_algorithm probes on a streamed carrier
 
 
 /**
  * @brief Steganography context structure.
  *
- * Holds the state of the secret buffer and the current position
- * during the embedding/extraction process.
+ * Holds the payload being hidden and the current position during the embedding process.
+ * The row callbacks embed one window of payload bytes at a time, so the payload does not
+ * have to be in memory.
  */
 typedef struct {
-    unsigned char *data_buffer;     // Complete buffer: [Size 4B] | [Data...] | [Ext. \0]
-    size_t data_buffer_len;         // Total length of the buffer in bytes
+    PayloadSource *payload;         // Stream being hidden: [Size 4B] | [Data...] | [Ext. \0]
+    size_t data_buffer_len;         // Total length of the stream in bytes
     size_t current_bit_idx;         // Index of the current bit being inserted (0-based)
+    const unsigned char *window;    // Payload bytes of the pixels being embedded (set by the row callbacks)
+    size_t window_first_byte;       // Stream offset of window[0]
+    size_t window_len;              // Bytes available from window
 
     unsigned char inversion_map;    // Mapa de inversion (para patrones 00, 01, 10, 11)
+    const LSBITables *lsbi_tables;  // LSBI lookup tables for inversion_map (NULL = built per span)
+    int bits_per_component;         // LSBn: payload bits per color component (1-4)
 } StegoContext;
 
 typedef struct {
-    int changed_count;
-    int unchanged_count;
+    uint64_t changed_count;
+    uint64_t unchanged_count;
 } PatternStats;
 
 typedef struct {
-    int bit_count;
-    Pixel current_pixel;
+    uint64_t bit_count;             // LSBI: components consumed, LSBn: stream bits consumed (64-bit: carriers may exceed 2^31 components)
     unsigned char inversion_map;
+    const LSBITables *lsbi_tables;  // LSBI: lookup tables for inversion_map, built once per extraction
+    int bits_per_component;         // Stream bits per color component (LSBn: 1-4, LSBI: 1 as bit_count counts components)
 } ExtractionContext;
 
-typedef int (*get_next_byte_func_t)(BMPImage *, ExtractionContext *);
+typedef int (*get_next_block_func_t)(BMPImage *, ExtractionContext *, unsigned char *out, size_t len);
+typedef uint64_t (*skip_payload_func_t)(uint64_t bit_count, uint64_t bytes);    // Value of bit_count `bytes` payload bytes later
 
 
 /**
- * @brief Hides the pre-built secret buffer inside a BMP using the LSB1 algorithm.
- * The BMPImage is already open (image->in) and the output file is linked (image->out).
+ * @brief Cursor over the byte stream an algorithm hides (size header first), opened by the
+ * algorithm's open_reader. Any later byte can be reached with skip without decoding the
+ * bytes in between.
+ */
+typedef struct {
+    ExtractionContext ctx;          // Position of the next byte
+    get_next_block_func_t read;     // Reads whole bytes from ctx and advances it
+    skip_payload_func_t skip;       // Value of ctx.bit_count a number of bytes further on
+    LSBITables lsbi_tables;         // LSBI: tables behind ctx.lsbi_tables (do not copy an open reader)
+} PayloadReader;
+
+/**
+ * @brief What the first bytes of a hidden payload say about it (see peek_payload).
+ */
+typedef struct {
+    uint32_t data_size;             // Size header: file size, or ciphertext length when encrypted
+    char extension[MAX_EXT_LEN];    // ".ext", '\0'-terminated (empty when encrypted)
+    size_t extension_len;           // Including the '\0' (0 when encrypted)
+    unsigned char head[PAYLOAD_HEAD_LEN];   // First bytes of the data section (encrypted payloads)
+    size_t head_len;
+} StegoPayloadInfo;
+
+typedef int (*payload_check_func_t)(const StegoPayloadInfo *info, void *ctx);  // Non-zero if the payload is plausible
+typedef int (*payload_sink_func_t)(void *ctx, const unsigned char *data, size_t len);   // Streamed extraction output: 0 or -1
+
+/**
+ * @brief Descriptor of a steganography algorithm, looked up by its -steg name.
  *
- * @param image Pointer to the initialized BMPImage structure (open by the caller)
- * @param secret_buffer Pointer to the pre-built buffer containing the message
- * @param buffer_len Total length of the secret_buffer in bytes
- * @return 0 on success, 1 on error.
+ * The handlers only go through these entries (capacity check, embed, extract), so an
+ * algorithm is added by adding a row to the registry in steganography.c.
  */
-int embed_lsb1(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len);
+typedef struct StegoAlgorithm {
+    const char *name;               // -steg value ("LSB1" .. "LSB4", "LSBI")
+    int bits_per_component;         // Payload bits per color component it writes
+    int bits_per_pixel;             // Payload bits per pixel (capacity unit)
+    size_t control_bits;            // Bits hidden ahead of the payload (LSBI inversion map)
+    int (*embed)(const struct StegoAlgorithm *algorithm, BMPImage *image, PayloadSource *payload);
+    int (*extract)(const struct StegoAlgorithm *algorithm, BMPImage *image, char encrypted,
+                   payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info);
+    int (*open_reader)(const struct StegoAlgorithm *algorithm, BMPImage *image, PayloadReader *reader);   // 0 or -1
+} StegoAlgorithm;
 
 /**
- * @brief Callback for LSB1: modifies a pixel by inserting 3 bits of the secret message
+ * @brief Looks up a steganography algorithm by name.
+ * @param name "LSB1", "LSB2", "LSB3", "LSB4" or "LSBI".
+ * @return The registry entry, or NULL if the name is unknown.
+ */
+const StegoAlgorithm *find_stego_algorithm(const char *name);
+
+/**
+ * @brief Reads the size header of the payload hidden with `algorithm` and, if not encrypted,
+ * jumps over the data to read the extension. Only a few pixels are decoded.
  *
- * This function is designed to be passed to the BMP iteration function (recorrer_bmp)
- * It inserts one bit of secret data into the Least Significant Bit (LSB)
- * of the Blue, Green, and Red components, sequentially
+ * The payload is accepted only if its size is non-zero and fits in the carrier and, when not
+ * encrypted, the extension starts with '.' and is terminated within MAX_EXT_LEN bytes.
+ * Nothing is printed, so wrong guesses can be probed silently. On a streamed carrier the
+ * rows before the extension are dropped on the way, so they cannot be decoded afterwards.
  *
- * @param pixel Pointer to the pixel (BGR) to modify
- * @param ctx Pointer to the context (StegoContext) holding the secret buffer and index.
+ * @param algorithm Registry entry of the algorithm to decode with.
+ * @param image Pointer to an opened BMPImage structure (the carrier).
+ * @param encrypted TRUE if the payload is encrypted (the extension is inside the ciphertext).
+ * @param info Filled with the size header and the extension (or, when encrypted, the first
+ * min(data_size, PAYLOAD_HEAD_LEN) ciphertext bytes).
+ * @return EXIT_SUCCESS if the header is plausible, EXIT_FAILURE otherwise.
  */
-void lsb1_embed_pixel_callback(Pixel *pixel, void *ctx);
+int peek_payload(const StegoAlgorithm *algorithm, BMPImage *image, char encrypted, StegoPayloadInfo *info);
 
+/**
+ * @brief Finds which registered algorithm hid a payload by probing each one's header
+ * (peek_payload), in registry order.
+ *
+ * A small encrypted size header also looks plausible to an algorithm reading fewer bits
+ * per component, so encrypted payloads should come with a check (e.g. decrypting the head
+ * and validating the inner size header).
+ * On a streamed carrier the probes keep the rows they read, so unencrypted payloads are
+ * only recognized up to STREAM_PROBE_BYTES (their extension has to be checked).
+ *
+ * @param image Pointer to an opened BMPImage structure (the carrier).
+ * @param encrypted TRUE if the payload is encrypted.
+ * @param check Extra validation of a candidate's header, or NULL.
+ * @param check_ctx Passed to check.
+ * @return The first algorithm whose header is plausible, or NULL if none is.
+ */
+const StegoAlgorithm *detect_stego_algorithm(BMPImage *image, char encrypted, payload_check_func_t check, void *check_ctx);
 
 /**
- * @brief Extracts a secret buffer from a BMP image using LSB1.
+ * @brief Extracts only bytes [offset, offset + length) of a hidden, unencrypted file.
  *
- * This function reads the BMP pixel data, extracts the LSB from each
- * color component, and reconstructs the hidden data.
- * It first extracts a 4-byte size header (Big Endian) to determine
- * the full data length, then extracts the data itself.
+ * The size header and the extension are read first (as peek_payload does), then the reader
+ * jumps straight to stream byte 4 + offset: payload byte i sits at a fixed component (LSBn)
+ * or pixel (LSBI, after the control bits), so nothing before the range is decoded and only
+ * the pages of the mapped carrier that hold it are read. The range is streamed to sink in
+ * chunks, each split among image->threads workers. A streamed carrier only moves forward:
+ * the rows before the range are dropped and the extension is read after the range.
  *
- * NOTE: The caller is responsible for freeing the returned buffer.
+ * @param algorithm Registry entry of the algorithm.
+ * @param image Pointer to an opened BMPImage structure (the carrier).
+ * @param offset First byte of the hidden file to extract.
+ * @param length Number of bytes; 0, or more than what is left, extracts up to the end.
+ * @param sink Receives the bytes of the range, in order.
+ * @param sink_ctx Passed to sink.
+ * @param info Set to the size header and the extension of the hidden file.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE on error (printed).
+ */
+int extract_payload_range(const StegoAlgorithm *algorithm, BMPImage *image, uint64_t offset, uint64_t length,
+                          payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info);
+
+/**
+ * @brief Reads bytes [offset, offset + len) of the data section of a hidden payload (the
+ * bytes after the size header), jumping straight to them like extract_payload_range.
+ * Nothing is printed. On a streamed carrier the rows before them are dropped.
  *
- * @param image Pointer to an *opened* BMPImage structure (must have valid 'in' file).
- * @param extracted_data_len Pointer to a size_t variable to store the length of the extracted data.
- * @param extension_len Pointer to a size_t variable to store the length of the extracted extension (including the trailing null byte '\0').
- * @return A pointer to the dynamically allocated buffer containing the extracted data,
- * or NULL on error (e.g., read error, allocation failure).
+ * @param algorithm Registry entry of the algorithm.
+ * @param image Pointer to an opened BMPImage structure (the carrier).
+ * @param offset First data byte to read.
+ * @param out Destination buffer (len bytes).
+ * @param len Number of bytes.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the bytes run past the end of the carrier.
  */
- unsigned char *lsb1_extract(BMPImage *image, size_t *extracted_data_len,size_t *extension_len, char encrypted);
+int read_payload_data(const StegoAlgorithm *algorithm, BMPImage *image, uint64_t offset, unsigned char *out, size_t len);
 
 /**
- * @brief Hides the pre-built secret buffer inside a BMP using the LSB4 algorithm.
+ * @brief Checks that a payload (plus the algorithm's control bits) fits in the carrier.
+ * @param algorithm Registry entry of the algorithm.
+ * @param image Pointer to the initialized BMPImage structure.
+ * @param buffer_len Length of the payload in bytes.
+ * @return TRUE if it fits, FALSE otherwise (the error is printed).
+ */
+int check_stego_capacity(const StegoAlgorithm *algorithm, const BMPImage *image, size_t buffer_len);
+
+/**
+ * @brief Hides a payload inside a BMP using LSBn (LSB1 .. LSB4).
+ *
+ * The payload is treated as one MSB-first bit stream and each color component (B,G,R)
+ * takes the next n bits in its n low bits. LSB1 and LSB4 are the n = 1 and n = 4 cases
+ * (vectorized kernels); with n = 3 the last component may be only partly payload.
+ * The carrier is open (image->in_map) and the output is open (open_output_bmp); the
+ * pixels are written through write_bmp_rows.
  *
  * @param image Pointer to the initialized BMPImage structure (open by the caller)
- * @param secret_buffer Pointer to the pre-built buffer containing the message
- * @param buffer_len Total length of the secret_buffer in bytes
+ * @param payload The message (Size|Data|Ext), in memory or streamed from the secret file
+ * @param bits_per_component n, from 1 to LSBN_MAX_BITS
  * @return 0 on success, 1 on error.
  */
-int embed_lsb4(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len);
+int embed_lsbn(BMPImage *image, PayloadSource *payload, int bits_per_component);
 
 /**
- * @brief Callback for LSB4: modifies a pixel by inserting 12 bits of the secret message.
+ * @brief Row callback for LSBn, meant for iterate_bmp_rows / write_bmp_rows.
  *
- * This function is designed to be passed to the BMP iteration function (iterate_bmp).
- * It inserts four bits of secret data into the 4 Least Significant Bits (LSBs)
- * of the Blue, Green, and Red components, sequentially.
- *
- * @param pixel Pointer to the pixel (BGR) to modify
- * @param ctx Pointer to the context (StegoContext) holding the secret buffer and index.
+ * @param span Contiguous run of pixels of one row (padding excluded)
+ * @param ctx Pointer to the context (StegoContext) holding the payload, index and n.
  */
-void lsb4_embed_pixel_callback(Pixel *pixel, void *ctx);
-
+void lsbn_embed_row_callback(const BMPSpan *span, void *ctx);
 
 /**
- * @brief Extracts a hidden secret payload from a BMP image using the LSB4 steganography algorithm.
+ * @brief Extracts a hidden secret payload from a BMP image using LSBn (LSB1 .. LSB4).
  *
- * This function reads the image pixel data, extracting 4 bits (a nibble) from the Least
- * Significant Bits (LSBs) of each color component (Blue, Green, Red) to reconstruct the
- * hidden content. It first extracts a 4-byte Big Endian size header, followed by the file
- * data, and finally the file extension (which is terminated by a null byte '\0').
+ * Reads the n low bits of each color component back into the MSB-first bit stream:
+ * first the 4-byte Big Endian size header, then the data, then (if not encrypted) the
+ * extension terminated by '\0'. The data is streamed to sink as it is decoded.
  *
- * @param image Pointer to an *opened* BMPImage structure (must have valid 'in' file).
- * @param extracted_data_len Pointer to a size_t variable to store the length of the extracted data.
- * @param extension_len Pointer to a size_t variable to store the length of the extracted extension (including the trailing null byte '\0').
- * @return A pointer to the dynamically allocated buffer containing the extracted data,
- * or NULL on error (e.g., read error, allocation failure).
+ * @param image Pointer to an *opened* BMPImage structure (carrier mapped, or streamed: its rows are read as they are decoded).
+ * @param bits_per_component n, from 1 to LSBN_MAX_BITS.
+ * @param encrypted TRUE if the payload is encrypted (the extension is inside the ciphertext).
+ * @param sink Receives the data section (file data, or ciphertext when encrypted), in order.
+ * @param sink_ctx Passed to sink.
+ * @param info Set to the size header and, if not encrypted, the extension.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE on error (e.g., read error, invalid header).
  */
-unsigned char *lsb4_extract(BMPImage *image, size_t *extracted_data_len, size_t *extension_len, char encrypted);
-
+int lsbn_extract(BMPImage *image, int bits_per_component, char encrypted, payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info);
 
 /**
- * @brief Hides the pre-built secret buffer inside a BMP using the LSBI (Improved) algorithm.
+ * @brief Hides a payload inside a BMP using the LSBI (Improved) algorithm.
+ *
+ * The payload is walked twice (inversion statistics, then the embedding), a window at a time.
  *
  * @param image Pointer to the initialized BMPImage structure (open by the caller)
- * @param secret_buffer Pointer to the pre-built buffer containing the message
- * @param buffer_len Total length of the secret_buffer in bytes (excluding LSBI control bits)
+ * @param payload The message (Size|Data|Ext), in memory or streamed from the secret file
  * @return 0 on success, 1 on error.
  */
-int embed_lsbi(BMPImage *image, const unsigned char *secret_buffer, size_t buffer_len);
+int embed_lsbi(BMPImage *image, PayloadSource *payload);
 
 /**
  * @brief Callback for LSBI: modifies a pixel component based on a bit inversion strategy.
@@ -136,23 +239,34 @@ int embed_lsbi(BMPImage *image, const unsigned char *secret_buffer, size_t buffe
  * the bit-inverse rule based on the 2nd and 3rd LSBs of the *cover* component to minimize changes.
  *
  * @param pixel Pointer to the pixel (BGR) to modify
- * @param ctx Pointer to the context (StegoContext) holding the secret buffer and index.
+ * @param ctx Pointer to the context (StegoContext) holding the index and the payload window
+ * covering the pixel (see lsbi_embed_row_callback).
  */
 void lsbi_embed_pixel_callback(Pixel *pixel, void *ctx);
 
+/**
+ * @brief Row callback for LSBI, meant for iterate_bmp_rows / iterate_bmp_spans.
+ *
+ * @param span Contiguous run of pixels of one row (padding excluded)
+ * @param ctx Pointer to the context (StegoContext) holding the payload, index and map.
+ */
+void lsbi_embed_row_callback(const BMPSpan *span, void *ctx);
+
 /**
  * @brief Extracts a hidden secret payload from a BMP image using the LSBI (LSB Improved) steganography algorithm.
  *
  * This function performs a multi-phase extraction:
  * 1. **Extracts a 4-bit Inversion Map** using standard LSB1 logic.
  * 2. **Applies conditional re-inversion** logic based on the Map and the 2nd/3rd LSBs of the carrier components, while **skipping the Red channel** (LSBI rule).
- * 3. Sequentially extracts the **Big Endian size header**, the file data, and the null-terminated extension, ensuring **MSB-first** assembly.
+ * 3. Sequentially extracts the **Big Endian size header**, the file data (streamed to sink as it is decoded), and the null-terminated extension, ensuring **MSB-first** assembly.
  *
  * @param image Pointer to an opened BMPImage structure (the carrier).
- * @param extracted_data_len Pointer to a size_t variable to store the length of the original file data (excluding extension).
- * @param extension_len Pointer to a size_t variable to store the length of the extracted extension (including the trailing null byte '\0').
- * @return A pointer to the dynamically allocated buffer containing the full extracted payload (Data || Extension), or NULL on error.
+ * @param encrypted TRUE if the payload is encrypted (the extension is inside the ciphertext).
+ * @param sink Receives the data section (file data, or ciphertext when encrypted), in order.
+ * @param sink_ctx Passed to sink.
+ * @param info Set to the size header and, if not encrypted, the extension.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE on error.
  */
-unsigned char *lsbi_extract(BMPImage *image, size_t *extracted_data_len, size_t *extension_len, char encrypted);
+int lsbi_extract(BMPImage *image, char encrypted, payload_sink_func_t sink, void *sink_ctx, StegoPayloadInfo *info);
 
 #endif
\ No newline at end of file